@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using Entity = uint32_t;
+
+//decides which enemies get to make decisions this frame (AI level of detail)
+//enemies are staggered by id so a tier's work is spread evenly over its period,
+//far away enemies think less often and a per frame budget pushes overflow to later frames
+class AIScheduler
+{
+    public:
+        struct Tier
+        {
+            float maxDist; //applies to enemies closer than this to their target
+            unsigned int period; //think every period frames
+        };
+
+        std::vector<Tier> tiers = {{400, 1}, {1000, 4}, {1e30f, 16}};
+        float budgetMs = 2.f; //decision time allowed per frame
+
+        void BeginFrame()
+        {
+            frame++;
+            spent = std::chrono::nanoseconds(0);
+            retry.clear();
+            retry.swap(deferred);
+        }
+
+        unsigned int Frame() const { return frame; }
+
+        //whether this enemy's turn comes up this frame, going by its last known distance
+        bool Scheduled(Entity ent, float targetDist) const
+        {
+            return (frame + ent) % Period(targetDist) == 0;
+        }
+
+        bool OverBudget() const
+        {
+            return spent >= std::chrono::duration<float, std::milli>(budgetMs);
+        }
+
+        //enemies that were due but didn't fit in the budget, they go first next frame
+        void Defer(Entity ent) { deferred.push_back(ent); }
+        const std::vector<Entity>& Retry() const { return retry; }
+
+        //time a decision, counts towards the budget
+        template<typename F>
+        void Think(F&& decide)
+        {
+            auto start = std::chrono::steady_clock::now();
+            decide();
+            spent += std::chrono::steady_clock::now() - start;
+        }
+
+    private:
+        unsigned int Period(float targetDist) const
+        {
+            for (auto& tier : tiers)
+            {
+                if (targetDist < tier.maxDist) { return tier.period; }
+            }
+            return tiers.empty() ? 1 : tiers.back().period;
+        }
+
+        unsigned int frame = 0;
+        std::chrono::nanoseconds spent{0};
+        std::vector<Entity> deferred; //collected this frame
+        std::vector<Entity> retry; //deferred last frame, handled at the start of this one
+};
@@ -3,22 +3,28 @@
 #include <SFML/Graphics.hpp>
 #include <box2d/box2d.h>
 #include <vector>
+#include <array>
+#include <tuple>
+#include <iterator>
+#include "gameParams.hpp"
 
 using Entity = uint32_t;
+constexpr Entity NoEntity = UINT32_MAX;
 
 //supporting structs and enums
 
-enum damageGroup //to specify who the bullet hits
+using LayerMask = uint32_t;
+
+enum CollisionLayer : LayerMask //bit flags, a bullet hits anything whose layer is in its mask
 {
-    friendly,
-    enemy,
-    both
+    friendly = 1 << 0,
+    enemy = 1 << 1,
+    both = friendly | enemy
 };
 
-struct Weapon
+struct Weapon //shared definition, see WeaponLibrary
 {
     float fireRate = 0; //bullets per second
-    float fireDelay = 0;
     int bulletSpeed = 0;
     int bulletSpread = 0; //degrees of offset
     int bulletsShot = 0;
@@ -27,7 +33,19 @@ struct Weapon
     int damage = 0;
     int bulletRadius = 0;
     int pierce = 0;
-    damageGroup dGroup = both;
+    LayerMask hitMask = both; //layers its bullets damage
+};
+
+using WeaponId = uint16_t;
+using AtlasId = uint16_t; //see TextureAtlas
+
+//reference to another entity's component, resolved with Registry::resolve
+//the pool slot is cached and reused for as long as the entity is still in it
+template<typename C>
+struct Ref
+{
+    Entity ent = NoEntity;
+    size_t slot = 0; //where ent was last seen, checked before use
 };
 
 //can be added to entities
@@ -44,7 +62,7 @@ struct Velocity
 struct Health
 {
     int hp = 3;
-    damageGroup dGroup;
+    LayerMask layer; //bullets with this in their mask hurt it
 };
 
 struct RenderHitboxes
@@ -52,6 +70,20 @@ struct RenderHitboxes
     sf::Color col = sf::Color::White;
 };
 
+struct Sprite //drawn centred on the Position, batched by layer then atlas
+{
+    AtlasId atlas = 0;
+    sf::IntRect rect; //texture rect in the atlas, TextureAtlas::Cell gives one
+    sf::Vector2f size; //on screen
+    int layer = 0; //higher draws on top
+    sf::Color tint = sf::Color::White;
+};
+
+struct Camera //the view follows this entity, only the first camera is used
+{
+    sf::Vector2f size = {(float)Params::gameW, (float)Params::gameH}; //world units on screen
+};
+
 struct PlayerMovement
 {
     int moveSpd = 100;
@@ -59,8 +91,20 @@ struct PlayerMovement
 
 struct WeaponArsenal
 {
+    static constexpr int maxSlots = 4;
+
     int selected = 0;
-    std::vector<Weapon> weapons;
+    int count = 0;
+    std::array<WeaponId, maxSlots> weapons{}; //ids into WeaponLibrary
+    std::array<double, maxSlots> readyAt{}; //game time each slot can fire again, nothing counts down
+
+    void Add(WeaponId id)
+    {
+        if (count == maxSlots) { return; }
+        weapons[count] = id;
+        readyAt[count] = 0;
+        count++;
+    }
 };
 
 struct CircleCollider
@@ -76,9 +120,9 @@ struct PlayerWeaponLogic
 struct Bullet
 {
     int damage = 1;
-    int pierce = 0;
-    damageGroup dGroup;
-    float lifeTime;
+    int pierce = 0; //extra targets it can go through before it's destroyed
+    LayerMask mask;
+    uint64_t expireTick = 0; //timer wheel tick it dies at, a timer that doesn't match is stale
 };
 
 struct Friction
@@ -86,24 +130,47 @@ struct Friction
     float friction;
 };
 
-struct EnemySafeMove
+struct Target //who the entity is after, set with Registry::SetTarget so it's cleared when the target dies
+{
+    Ref<Position> pos;
+};
+
+struct EnemySafeMove //goes after the entity's Target
 {
-    Entity target;
     bool walkAndShoot;
     int moveSpd;
     std::vector<int> range;
+    bool followLanes = false; //path along enemy lanes/waypoints instead of any open tile
+    sf::Vector2f moveDir = {0, 0}; //last decision, applied every frame in between
 };
 
-struct EnemyShootingLogic
+struct EnemyShootingLogic //shoots at the entity's Target
 {
     float moveDelay; //amount of time to stand still after a shot
-    Entity target;
-    float moveTimer = 0;
+    double moveUntil = 0; //game time it can move again
+    bool targetVisible = true; //no walls in the way, refreshed every frame by CheckLineOfSight
+};
+
+struct AILod //enemies with this only make decisions when the AIScheduler lets them
+{
+    float targetDist = 0; //from the last decision, picks the update rate
+    unsigned int lastThink = 0;
+    bool pending = false; //was due but ran out of budget
 };
 
 //YOU NEED TO ADD YOUR NEW COMPONENTS HERE FOR THEM TO BE AVAILABLE ON THE ENTITIES
 using AllComponents = std::tuple
 <
     EnemyShootingLogic, EnemySafeMove, Friction, Position, Velocity, CircleCollider, 
-    Health, RenderHitboxes, PlayerMovement, WeaponArsenal, Bullet, PlayerWeaponLogic
->;
\ No newline at end of file
+    Health, RenderHitboxes, PlayerMovement, WeaponArsenal, Bullet, PlayerWeaponLogic,
+    AILod, Target, Sprite, Camera
+>;
+
+//names for debug output, same order as AllComponents
+constexpr const char* componentNames[] =
+{
+    "EnemyShootingLogic", "EnemySafeMove", "Friction", "Position", "Velocity", "CircleCollider",
+    "Health", "RenderHitboxes", "PlayerMovement", "WeaponArsenal", "Bullet", "PlayerWeaponLogic",
+    "AILod", "Target", "Sprite", "Camera"
+};
+static_assert(std::size(componentNames) == std::tuple_size_v<AllComponents>, "name every component");
\ No newline at end of file
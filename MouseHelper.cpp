@@ -11,4 +11,9 @@ void MouseHelper::SetWindow(sf::RenderWindow* rendWindow)
 sf::Vector2i MouseHelper::GetMousePos()
 {
     return sf::Mouse::getPosition(*window);
+}
+
+sf::Vector2f MouseHelper::GetMouseWorldPos(const sf::View& view)
+{
+    return window->mapPixelToCoords(GetMousePos(), view);
 }
\ No newline at end of file
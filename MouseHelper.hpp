@@ -9,4 +9,6 @@ class MouseHelper
     public:
         static void SetWindow(sf::RenderWindow* rendWindow);
         static sf::Vector2i GetMousePos();
+        //mouse position in the world seen through the view
+        static sf::Vector2f GetMouseWorldPos(const sf::View& view);
 };
\ No newline at end of file
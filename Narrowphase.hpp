@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROWPHASE_SSE2 1
+#endif
+
+//circle vs circle overlap tests for a batch of candidate pairs
+//pairs are stored as parallel arrays so four can be tested per instruction,
+//and everything is compared squared so there's no sqrt
+class CirclePairBatch
+{
+    public:
+        void Clear()
+        {
+            ax.clear(); ay.clear(); bx.clear(); by.clear(); rr.clear();
+        }
+
+        //returns the pair's index, which Overlapping reports back
+        uint32_t Add(float aX, float aY, float bX, float bY, float radiusSum)
+        {
+            ax.push_back(aX); ay.push_back(aY);
+            bx.push_back(bX); by.push_back(bY);
+            rr.push_back(radiusSum * radiusSum);
+            return (uint32_t)(rr.size() - 1);
+        }
+
+        //appends the indices of every overlapping pair, in order
+        void Overlapping(std::vector<uint32_t>& out) const
+        {
+            size_t n = rr.size();
+            size_t i = 0;
+#ifdef NARROWPHASE_SSE2
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps(&ax[i]), _mm_loadu_ps(&bx[i]));
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(&ay[i]), _mm_loadu_ps(&by[i]));
+                __m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                int hits = _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_loadu_ps(&rr[i])));
+                while (hits)
+                {
+                    int lane = 0;
+                    while (!(hits & (1 << lane))) { lane++; }
+                    out.push_back((uint32_t)(i + lane));
+                    hits &= hits - 1;
+                }
+            }
+#endif
+            for (; i < n; i++)
+            {
+                float dx = ax[i] - bx[i];
+                float dy = ay[i] - by[i];
+                if (dx * dx + dy * dy <= rr[i]) { out.push_back((uint32_t)i); }
+            }
+        }
+
+    private:
+        std::vector<float> ax, ay, bx, by;
+        std::vector<float> rr; //squared radius sums
+};
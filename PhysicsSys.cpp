@@ -0,0 +1,246 @@
+#include "PhysicsSys.hpp"
+#include "Systems.hpp"
+#include "gameParams.hpp"
+#include "tile_level_loader/level_system.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+using ls = LevelSystem;
+
+namespace
+{
+    b2Vec2 ToB2(sf::Vector2f v)
+    {
+        return b2Vec2(v.x / Params::b2ScaleFactor, v.y / Params::b2ScaleFactor);
+    }
+
+    sf::Vector2f FromB2(b2Vec2 v)
+    {
+        return sf::Vector2f(v.x * Params::b2ScaleFactor, v.y * Params::b2ScaleFactor);
+    }
+}
+
+PhysicsSys::PhysicsSys() : world(std::make_unique<b2World>(b2Vec2(0, 0)))
+{
+    world->SetAllowSleeping(true);
+    world->SetContactListener(&listener);
+}
+
+PhysicsSys::~PhysicsSys() = default;
+
+void PhysicsSys::ContactListener::BeginContact(b2Contact* contact)
+{
+    begun.push_back({contact->GetFixtureA()->GetBody()->GetUserData().pointer,
+                     contact->GetFixtureB()->GetBody()->GetUserData().pointer});
+}
+
+void PhysicsSys::AddExisting(EntityManager& em)
+{
+    for (auto ent : em.getAllEnt<CircleCollider>())
+    {
+        AddBody(em, ent);
+    }
+}
+
+void PhysicsSys::AddBody(EntityManager& em, Entity ent)
+{
+    if (!em.has<CircleCollider, Velocity, Position>(ent)) { return; }
+    if (entToLink.contains(ent)) { return; }
+
+    auto pos = em.get<Position>(ent)->pos;
+    bool isBullet = em.has<Bullet>(ent);
+
+    b2BodyDef def;
+    def.type = b2_dynamicBody;
+    def.position = ToB2(pos);
+    def.fixedRotation = true;
+    def.bullet = isBullet;
+    def.userData.pointer = (uintptr_t)ent + 1;
+    auto body = world->CreateBody(&def);
+
+    b2CircleShape shape;
+    shape.m_radius = (float)em.get<CircleCollider>(ent)->radius / Params::b2ScaleFactor;
+
+    b2FixtureDef fix;
+    fix.shape = &shape;
+    fix.density = 1;
+    //bullets only report overlaps, they never push anything around or hit each other
+    fix.isSensor = isBullet;
+    fix.filter.categoryBits = isBullet ? catBullet : catBody;
+    fix.filter.maskBits = isBullet ? (catBody | catWall) : (catBody | catBullet | catWall);
+    body->CreateFixture(&fix);
+
+    entToLink[ent] = links.size();
+    links.push_back(BodyLink{ent, body, pos});
+}
+
+void PhysicsSys::RemoveBody(Entity ent)
+{
+    auto it = entToLink.find(ent);
+    if (it == entToLink.end()) { return; }
+
+    size_t index = it->second;
+    world->DestroyBody(links[index].body);
+
+    //swap remove, same as the component pools
+    links[index] = links.back();
+    entToLink[links[index].ent] = index;
+    links.pop_back();
+    entToLink.erase(ent);
+}
+
+void PhysicsSys::RebuildWalls()
+{
+    for (auto body : walls) { world->DestroyBody(body); }
+    walls.clear();
+    for (auto& [key, bodies] : chunkWalls)
+    {
+        for (auto body : bodies) { world->DestroyBody(body); }
+    }
+    chunkWalls.clear();
+    wallVersion = ls::get_version();
+
+    //a streamed level only gets walls where it's loaded, a chunk at a time
+    if (ls::is_streamed()) { SyncChunkWalls(); return; }
+    AddWallRuns(sf::IntRect(0, 0, ls::get_width(), ls::get_height()), walls);
+}
+
+//add walls for chunks that came in, drop the ones of chunks that went
+void PhysicsSys::SyncChunkWalls()
+{
+    wallResidentVersion = ls::get_resident_version();
+    auto layer = ls::get_tile_layer();
+    if (!layer) { return; }
+
+    constexpr int ct = ls::TileLayer::CHUNK_TILES;
+    std::unordered_set<uint64_t> loaded;
+    for (auto& chunk : layer->resident)
+    {
+        uint64_t key = (uint64_t)chunk.y << 32 | (uint32_t)chunk.x;
+        loaded.insert(key);
+        if (chunkWalls.contains(key)) { continue; }
+        AddWallRuns(sf::IntRect(chunk.x * ct, chunk.y * ct, ct, ct), chunkWalls[key]);
+    }
+    for (auto it = chunkWalls.begin(); it != chunkWalls.end();)
+    {
+        if (loaded.contains(it->first)) { ++it; continue; }
+        for (auto body : it->second) { world->DestroyBody(body); }
+        it = chunkWalls.erase(it);
+    }
+}
+
+//one static box per horizontal run of solid tiles in the area
+void PhysicsSys::AddWallRuns(sf::IntRect area, std::vector<b2Body*>& out)
+{
+    float ts = ls::get_tile_size();
+    int right = std::min(area.left + area.width, ls::get_width());
+    int bottom = std::min(area.top + area.height, ls::get_height());
+    for (int y = area.top; y < bottom; y++)
+    {
+        int x = area.left;
+        while (x < right)
+        {
+            if (!ls::is_solid(ls::get_tile_or({x, y}))) { x++; continue; }
+            int start = x;
+            while (x < right && ls::is_solid(ls::get_tile_or({x, y}))) { x++; }
+
+            auto tl = ls::get_tile_position({start, y});
+            sf::Vector2f size((x - start) * ts, ts);
+
+            b2BodyDef def;
+            def.type = b2_staticBody;
+            def.position = ToB2(tl + size / 2.f);
+            def.userData.pointer = wallTag;
+            auto body = world->CreateBody(&def);
+
+            b2PolygonShape box;
+            box.SetAsBox(size.x / 2 / Params::b2ScaleFactor, size.y / 2 / Params::b2ScaleFactor);
+            b2FixtureDef fix;
+            fix.shape = &box;
+            fix.filter.categoryBits = catWall;
+            fix.filter.maskBits = catBody | catBullet;
+            body->CreateFixture(&fix);
+            out.push_back(body);
+        }
+    }
+}
+
+void PhysicsSys::Update(EntityManager& em, float dt)
+{
+    //bring the body list in line with the ecs
+    for (auto ent : em.Destroyed()) { RemoveBody(ent); }
+    for (auto ent : em.Created()) { AddBody(em, ent); }
+    if (wallVersion != ls::get_version()) { RebuildWalls(); }
+    else if (ls::is_streamed() && wallResidentVersion != ls::get_resident_version()) { SyncChunkWalls(); }
+
+    //push: only touch box2d when the ecs actually changed something,
+    //so untouched bodies are allowed to fall asleep
+    for (auto& link : links)
+    {
+        auto pos = em.get<Position>(link.ent)->pos;
+        if (pos != link.lastPos)
+        {
+            link.body->SetTransform(ToB2(pos), 0);
+        }
+        auto vel = ToB2(em.get<Velocity>(link.ent)->vel);
+        auto cur = link.body->GetLinearVelocity();
+        if (vel.x != cur.x || vel.y != cur.y)
+        {
+            link.body->SetLinearVelocity(vel);
+        }
+    }
+
+    accumulator += dt;
+    int steps = 0;
+    while (accumulator >= fixedStep && steps < maxSteps)
+    {
+        world->Step(fixedStep, 8, 3);
+        accumulator -= fixedStep;
+        steps++;
+    }
+    if (steps == maxSteps) { accumulator = 0; }
+
+    //pull: sleeping bodies haven't moved, skip them
+    for (auto& link : links)
+    {
+        if (!link.body->IsAwake()) { continue; }
+        auto pos = FromB2(link.body->GetPosition());
+        em.get<Position>(link.ent)->pos = pos;
+        em.get<Velocity>(link.ent)->vel = FromB2(link.body->GetLinearVelocity());
+        link.lastPos = pos;
+    }
+
+    ApplyContacts(em);
+}
+
+void PhysicsSys::ApplyContacts(EntityManager& em)
+{
+    std::unordered_set<Entity> spent; //a bullet can touch several things in one step, only the first counts
+    for (auto [a, b] : listener.begun)
+    {
+        //put the bullet first
+        if (a == wallTag || !em.has<Bullet>((Entity)(a - 1))) { std::swap(a, b); }
+        if (a == wallTag) { continue; }
+        Entity bulEnt = (Entity)(a - 1);
+        if (!em.has<Bullet>(bulEnt) || spent.contains(bulEnt)) { continue; }
+
+        //bullets die on walls
+        if (b == wallTag)
+        {
+            spent.insert(bulEnt);
+            em.Destroy(bulEnt);
+            continue;
+        }
+
+        Entity other = (Entity)(b - 1);
+        if (!em.has<Health>(other)) { continue; }
+        auto bul = em.get<Bullet>(bulEnt);
+        auto hp = em.get<Health>(other);
+        if (!(bul->mask & hp->layer)) { continue; }
+        hp->hp -= bul->damage;
+        if (bul->pierce-- > 0) { continue; } //sensor contacts only begin once per pair
+        spent.insert(bulEnt);
+        em.Destroy(bulEnt);
+    }
+    listener.begun.clear();
+}
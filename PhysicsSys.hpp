@@ -0,0 +1,69 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <box2d/box2d.h>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+using Entity = uint32_t;
+class EntityManager;
+
+//optional box2d backend for entities with CircleCollider + Velocity + Position
+//the ecs stays the source of truth: velocities are pushed in, positions pulled out
+class PhysicsSys
+{
+    public:
+        PhysicsSys();
+        ~PhysicsSys();
+
+        //create bodies for everything that already exists
+        void AddExisting(EntityManager& em);
+
+        //sync bodies with last frame's created/destroyed entities, push velocities,
+        //run fixed steps and pull positions back. bullet hits are applied to Health
+        void Update(EntityManager& em, float dt);
+
+    private:
+        static constexpr float fixedStep = 1.f / 60.f;
+        static constexpr int maxSteps = 4; //don't spiral when a frame takes too long
+
+        //fixture filter categories
+        static constexpr uint16_t catBody = 0x1;
+        static constexpr uint16_t catBullet = 0x2;
+        static constexpr uint16_t catWall = 0x4;
+
+        //user data 0 marks level walls, entities are stored as id+1
+        static constexpr uintptr_t wallTag = 0;
+
+        struct BodyLink
+        {
+            Entity ent;
+            b2Body* body;
+            sf::Vector2f lastPos; //what we last wrote into the ecs, to detect teleports
+        };
+
+        class ContactListener : public b2ContactListener
+        {
+            public:
+                std::vector<std::pair<uintptr_t, uintptr_t>> begun;
+                void BeginContact(b2Contact* contact) override;
+        };
+
+        void AddBody(EntityManager& em, Entity ent);
+        void RemoveBody(Entity ent);
+        void RebuildWalls();
+        void SyncChunkWalls();
+        void AddWallRuns(sf::IntRect area, std::vector<b2Body*>& out);
+        void ApplyContacts(EntityManager& em);
+
+        std::unique_ptr<b2World> world;
+        ContactListener listener;
+        std::vector<BodyLink> links;
+        std::unordered_map<Entity, size_t> entToLink;
+        std::vector<b2Body*> walls;
+        std::unordered_map<uint64_t, std::vector<b2Body*>> chunkWalls; //streamed levels: walls of each loaded chunk
+        uint32_t wallVersion = 0;
+        uint32_t wallResidentVersion = 0;
+        float accumulator = 0;
+};
@@ -1,14 +1,35 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <bitset>
 #include <tuple>
+#include <algorithm>
 
 #include "Comps.hpp"
 
 using Entity = uint32_t;
 
+//memory use of one component pool, bytes are shallow (heap owned by a component isn't counted)
+struct PoolStats
+{
+    const char* name;
+    size_t live; //components in the pool
+    size_t capacity; //components the pool can hold without growing
+    size_t highWater; //most components the pool has held
+    size_t bytes;
+};
+
+struct RegistryStats
+{
+    size_t entities;
+    size_t entityBytes; //entToBit
+    size_t freeIds; //removedEnt
+    size_t freeIdBytes;
+    std::vector<PoolStats> pools;
+};
+
 class Registry {
 protected:
     static const size_t maxComp = std::tuple_size_v<AllComponents>;
@@ -16,14 +37,54 @@ protected:
     std::vector<Entity> removedEnt; //cached free id spots for createentity()
     std::vector<Entity> toRemove; //to prevent errors with altering container size while looping through it
     std::unordered_map<Entity, std::bitset<maxComp>> toAdd; //^same logic as above 
+    std::vector<Entity> created; //entities added/destroyed by the last HandleCreationAndDestruction,
+    std::vector<Entity> destroyed; //so systems keeping their own per entity data can catch up
+    std::unordered_map<Entity, std::unordered_set<Entity>> targetedBy; //reverse of Target, for clearing on destruction
 
     template<typename C>
     struct ComponentStorage {
         std::vector<C> data;
         std::unordered_map<Entity, size_t> entityToIndex;
         std::vector<Entity> indexToEntity; //for comp removal
+        size_t highWater = 0;
     };
 
+    //rough footprint of a node based unordered_map: bucket array + one node per element
+    template<typename Map>
+    static size_t MapBytes(const Map& map)
+    {
+        return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+    }
+
+    template<typename C>
+    PoolStats poolStats(const char* name)
+    {
+        auto& store = storage<C>();
+        return PoolStats{name, store.data.size(), store.data.capacity(), store.highWater,
+            store.data.capacity() * sizeof(C) + store.indexToEntity.capacity() * sizeof(Entity) + MapBytes(store.entityToIndex)};
+    }
+
+    template<std::size_t... I>
+    void collectPoolStats(std::vector<PoolStats>& out, std::index_sequence<I...>)
+    {
+        (out.push_back(poolStats<std::tuple_element_t<I, AllComponents>>(componentNames[I])), ...);
+    }
+
+    template<typename C>
+    void shrinkPool()
+    {
+        auto& store = storage<C>();
+        store.data.shrink_to_fit();
+        store.indexToEntity.shrink_to_fit();
+        store.entityToIndex.rehash(0);
+    }
+
+    template<std::size_t... I>
+    void shrinkPools(std::index_sequence<I...>)
+    {
+        (shrinkPool<std::tuple_element_t<I, AllComponents>>(), ...);
+    }
+
     //sourced from https://stackoverflow.com/questions/18063451/get-index-of-a-tuple-elements-type
     template <class T, class Tuple>
     struct Index;
@@ -40,11 +101,20 @@ protected:
     };
     //end source
 
+    //one pool per component type, owned by this registry so scenes don't share entities
+    template<typename Tuple>
+    struct PoolTuple;
+
+    template<typename... Cs>
+    struct PoolTuple<std::tuple<Cs...>> {
+        using type = std::tuple<ComponentStorage<Cs>...>;
+    };
+
+    typename PoolTuple<AllComponents>::type pools;
+
     template<typename C>
     ComponentStorage<C>& storage() {
-        // One instance per component type C
-        static ComponentStorage<C> s;
-        return s;
+        return std::get<ComponentStorage<C>>(pools);
     }
 
     template<std::size_t... I>
@@ -56,21 +126,54 @@ protected:
             : void()), ...);
     }
 
+    void Untarget(Entity e, Entity target)
+    {
+        auto it = targetedBy.find(target);
+        if (it == targetedBy.end()) { return; }
+        it->second.erase(e);
+        if (it->second.empty()) { targetedBy.erase(it); }
+    }
+
+    void UnlinkTargets(Entity e)
+    {
+        //stop being a dependent of whatever e was targeting
+        auto& targets = storage<Target>();
+        auto own = targets.entityToIndex.find(e);
+        if (own != targets.entityToIndex.end()) { Untarget(e, targets.data[own->second].pos.ent); }
+
+        //clear everyone targeting e in one go, before the id can be reused
+        auto it = targetedBy.find(e);
+        if (it == targetedBy.end()) { return; }
+        for (auto dep : it->second)
+        {
+            auto dIt = targets.entityToIndex.find(dep);
+            if (dIt != targets.entityToIndex.end()) { targets.data[dIt->second].pos = Ref<Position>{}; }
+        }
+        targetedBy.erase(it);
+    }
+
     void HandleCreationAndDestruction() //this is to prevent adding or deleting entities mid loop
     {
+        created.clear();
+        destroyed.clear();
+
         //addition
         for (auto e : toAdd)
         {
             entToBit.insert(e);
+            created.push_back(e.first);
         }
         toAdd.clear();
 
         //destruction
         for (auto e : toRemove)
         {
+            if (!entToBit.contains(e)) { continue; } //already destroyed this frame by another system
+            UnlinkTargets(e);
             destroyComps(e, std::make_index_sequence<std::tuple_size_v<AllComponents>>{});
             entToBit.erase(entToBit.find(e));
             removedEnt.push_back(e);
+            destroyed.push_back(e);
         }
         toRemove.clear();
     }
@@ -100,6 +203,7 @@ public:
         store.entityToIndex[e] = store.data.size(); //match index to array with entity
         store.indexToEntity.push_back(e);           //for removal
         store.data.push_back(component);            //add data to array
+        store.highWater = std::max(store.highWater, store.data.size());
 
         //update bitset
         if (toAdd.find(e) != toAdd.end()) //if not been added yet, alter to add
@@ -176,4 +280,61 @@ public:
         if (entToBit.find(e) == entToBit.end()){return false;}
         return true;
     }
+
+    //point e at target, adds the Target component if needed
+    void SetTarget(Entity e, Entity target)
+    {
+        auto& store = storage<Target>();
+        if (!store.entityToIndex.contains(e)) { add<Target>(e, Target{}); }
+        auto& t = store.data[store.entityToIndex[e]];
+        if (t.pos.ent != NoEntity) { Untarget(e, t.pos.ent); }
+        t.pos = Ref<Position>{target};
+        if (target != NoEntity) { targetedBy[target].insert(e); }
+    }
+
+    //entities whose Target is e
+    std::vector<Entity> TargetedBy(Entity e)
+    {
+        auto it = targetedBy.find(e);
+        if (it == targetedBy.end()) { return {}; }
+        return std::vector<Entity>(it->second.begin(), it->second.end());
+    }
+
+    //follow a Ref, a direct index unless its entity has moved to another slot
+    //only looks the entity up again when the slot now holds someone else,
+    //so removals and reorders elsewhere in the pool don't cost anything
+    template<typename C>
+    C* resolve(Ref<C>& ref)
+    {
+        if (ref.ent == NoEntity) { return nullptr; }
+        auto& store = storage<C>();
+        if (ref.slot < store.indexToEntity.size() && store.indexToEntity[ref.slot] == ref.ent) { return &store.data[ref.slot]; }
+
+        if (!entToBit.contains(ref.ent)) { return nullptr; }
+        auto it = store.entityToIndex.find(ref.ent);
+        if (it == store.entityToIndex.end()) { return nullptr; }
+        ref.slot = it->second;
+        return &store.data[ref.slot];
+    }
+
+    size_t EntityCount() const { return entToBit.size(); }
+
+    RegistryStats Stats()
+    {
+        RegistryStats stats{entToBit.size(), MapBytes(entToBit), removedEnt.size(), removedEnt.capacity() * sizeof(Entity), {}};
+        stats.pools.reserve(maxComp);
+        collectPoolStats(stats.pools, std::make_index_sequence<maxComp>{});
+        return stats;
+    }
+
+    //give back memory left over from spikes (e.g. after a bullet storm), pools regrow on demand
+    void ShrinkToFit()
+    {
+        shrinkPools(std::make_index_sequence<maxComp>{});
+        entToBit.rehash(0);
+        removedEnt.shrink_to_fit();
+    }
+
+    const std::vector<Entity>& Created() const { return created; }
+    const std::vector<Entity>& Destroyed() const { return destroyed; }
 };
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "RenderPipeline.hpp"
+#include <algorithm>
+
+RenderPipeline::RenderPipeline(sf::RenderWindow& window) : window(window)
+{
+    //the gl context can only be active on one thread at a time
+    window.setActive(false);
+    thread = std::thread(&RenderPipeline::Run, this);
+}
+
+RenderPipeline::~RenderPipeline()
+{
+    Stop();
+}
+
+RenderFrame& RenderPipeline::BeginFrame()
+{
+    frames[writeIdx].Clear();
+    return frames[writeIdx];
+}
+
+void RenderPipeline::Submit()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    //don't get more than one frame ahead of what's on screen
+    cv.wait(lock, [this]{ return !fresh || !running; });
+    std::swap(writeIdx, readyIdx);
+    fresh = true;
+    cv.notify_all();
+}
+
+void RenderPipeline::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) { return; }
+        running = false;
+    }
+    cv.notify_all();
+    if (thread.joinable()) { thread.join(); }
+    window.setActive(true);
+}
+
+void RenderPipeline::Run()
+{
+    window.setActive(true);
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]{ return fresh || !running; });
+            if (!running) { break; }
+            std::swap(drawIdx, readyIdx);
+            fresh = false;
+        }
+        cv.notify_all(); //simulation may be waiting to submit
+
+        window.clear();
+        Draw(frames[drawIdx]);
+        window.display();
+    }
+    window.setActive(false);
+}
+
+void RenderPipeline::Draw(const RenderFrame& frame)
+{
+    window.setView(frame.view);
+    sf::FloatRect visible(frame.view.getCenter() - frame.view.getSize() / 2.f, frame.view.getSize());
+    if (frame.tiles) { frame.tiles->draw(window, visible); }
+
+    DrawSprites(frame.sprites);
+
+    for (auto& c : frame.circles)
+    {
+        circle.setRadius(c.radius);
+        circle.setOrigin(sf::Vector2f(c.radius, c.radius));
+        circle.setPosition(c.pos);
+        circle.setFillColor(c.col);
+        window.draw(circle);
+    }
+
+    if (!frame.overlay.empty())
+    {
+        if (!fontLoaded)
+        {
+            fontLoaded = font.loadFromFile("res/fonts/ARIAL.TTF");
+            if (!fontLoaded) { return; }
+            overlayText.setFont(font);
+            overlayText.setCharacterSize(14);
+            overlayText.setFillColor(sf::Color::White);
+            overlayText.setOutlineColor(sf::Color::Black);
+            overlayText.setOutlineThickness(1);
+            overlayText.setPosition(sf::Vector2f(8, 8));
+        }
+        overlayText.setString(frame.overlay);
+        window.setView(window.getDefaultView());
+        window.draw(overlayText);
+    }
+}
+
+const sf::Texture* RenderPipeline::AtlasTexture(AtlasId id)
+{
+    if (textureState[id] == 0)
+    {
+        textureState[id] = textures[id].loadFromFile(TextureAtlas::Get(id).path) ? 1 : -1;
+    }
+    return textureState[id] == 1 ? &textures[id] : nullptr;
+}
+
+void RenderPipeline::DrawSprites(const std::vector<RenderSprite>& sprites)
+{
+    //one draw call per run of sprites sharing a layer and atlas
+    //stable so sprites within a batch keep the order they were snapshotted in
+    spriteOrder.resize(sprites.size());
+    for (uint32_t i = 0; i < spriteOrder.size(); i++) { spriteOrder[i] = i; }
+    std::stable_sort(spriteOrder.begin(), spriteOrder.end(), [&sprites](uint32_t a, uint32_t b)
+    {
+        if (sprites[a].layer != sprites[b].layer) { return sprites[a].layer < sprites[b].layer; }
+        return sprites[a].atlas < sprites[b].atlas;
+    });
+
+    size_t start = 0;
+    while (start < spriteOrder.size())
+    {
+        auto& first = sprites[spriteOrder[start]];
+        size_t end = start + 1;
+        while (end < spriteOrder.size() && sprites[spriteOrder[end]].layer == first.layer &&
+            sprites[spriteOrder[end]].atlas == first.atlas)
+        {
+            end++;
+        }
+
+        const sf::Texture* texture = AtlasTexture(first.atlas);
+        if (texture)
+        {
+            batch.resize((end - start) * 6);
+            size_t v = 0;
+            for (size_t i = start; i < end; i++)
+            {
+                auto& s = sprites[spriteOrder[i]];
+                sf::Vector2f half = s.size * 0.5f;
+                sf::Vector2f tl = s.pos - half;
+                sf::Vector2f br = s.pos + half;
+                float u0 = (float)s.rect.left;
+                float v0 = (float)s.rect.top;
+                float u1 = u0 + s.rect.width;
+                float v1 = v0 + s.rect.height;
+
+                batch[v++] = sf::Vertex(tl, s.tint, sf::Vector2f(u0, v0));
+                batch[v++] = sf::Vertex(sf::Vector2f(br.x, tl.y), s.tint, sf::Vector2f(u1, v0));
+                batch[v++] = sf::Vertex(br, s.tint, sf::Vector2f(u1, v1));
+                batch[v++] = sf::Vertex(tl, s.tint, sf::Vector2f(u0, v0));
+                batch[v++] = sf::Vertex(br, s.tint, sf::Vector2f(u1, v1));
+                batch[v++] = sf::Vertex(sf::Vector2f(tl.x, br.y), s.tint, sf::Vector2f(u0, v1));
+            }
+            window.draw(batch, sf::RenderStates(texture));
+        }
+        start = end;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TextureAtlas.hpp"
+#include "tile_level_loader/level_system.hpp"
+
+//everything the render thread needs to draw one frame, filled by the simulation
+struct RenderCircle
+{
+    sf::Vector2f pos;
+    float radius;
+    sf::Color col;
+};
+
+struct RenderSprite
+{
+    sf::Vector2f pos;
+    sf::Vector2f size;
+    sf::IntRect rect;
+    sf::Color tint;
+    AtlasId atlas;
+    int layer;
+};
+
+struct RenderFrame
+{
+    sf::View view; //camera, everything but the overlay is drawn through it
+    std::shared_ptr<const LevelSystem::TileLayer> tiles; //level layer, shared until the level changes, culled to the view
+    std::vector<RenderCircle> circles; //only what's near the view
+    std::vector<RenderSprite> sprites; //any order, sorted into batches by the render thread
+    std::string overlay; //debug text drawn in screen space, empty for none
+
+    void Clear()
+    {
+        tiles.reset();
+        circles.clear(); //keeps capacity, frames are reused
+        sprites.clear();
+        overlay.clear();
+    }
+};
+
+//runs drawing on its own thread so frame N draws while frame N+1 simulates
+//three frames rotate: one being filled, one waiting, one being drawn
+//the window is created on the main thread (events stay there) but only the render thread draws to it
+class RenderPipeline
+{
+    public:
+        explicit RenderPipeline(sf::RenderWindow& window);
+        ~RenderPipeline();
+
+        //frame for the simulation to fill, cleared and ready
+        RenderFrame& BeginFrame();
+        //hand the filled frame over, waits only if the render thread is a whole frame behind
+        void Submit();
+        //join the render thread, call before closing the window
+        void Stop();
+
+    private:
+        void Run();
+        void Draw(const RenderFrame& frame);
+        void DrawSprites(const std::vector<RenderSprite>& sprites);
+        //null if the atlas image couldn't be loaded, only tried once
+        const sf::Texture* AtlasTexture(AtlasId id);
+
+        sf::RenderWindow& window;
+        std::array<RenderFrame, 3> frames;
+        int writeIdx = 0;
+        int readyIdx = 1;
+        int drawIdx = 2;
+        bool fresh = false; //readyIdx holds a frame that hasn't been drawn
+        bool running = true;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread thread;
+
+        sf::CircleShape circle; //reused for every circle
+        std::array<sf::Texture, TextureAtlas::maxAtlases> textures;
+        std::array<signed char, TextureAtlas::maxAtlases> textureState{}; //0 not tried, 1 loaded, -1 failed
+        std::vector<uint32_t> spriteOrder; //indices into the frame's sprites, sorted per draw
+        sf::VertexArray batch{sf::Triangles}; //rebuilt for each layer/atlas run
+        sf::Font font; //loaded on the render thread the first time there's overlay text
+        sf::Text overlayText;
+        bool fontLoaded = false;
+};
@@ -0,0 +1,59 @@
+#include "SceneManager.hpp"
+#include <chrono>
+
+std::unique_ptr<Scene> SceneManager::current;
+std::future<std::unique_ptr<Scene>> SceneManager::pending;
+std::future<void> SceneManager::retiring;
+
+void SceneManager::SwapIfReady()
+{
+    if (!pending.valid()) { return; }
+    if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) { return; }
+
+    auto next = pending.get(); //rethrows anything the loader threw
+    auto oldLevel = next->Activate();
+    auto old = std::move(current);
+    current = std::move(next);
+    Retire(std::move(old), std::move(oldLevel));
+}
+
+//tearing down a big registry or level can take a while, don't do it on the frame
+void SceneManager::Retire(std::unique_ptr<Scene> scene, LevelSystem::LevelData level)
+{
+    if (!scene && !level.tiles && !level.stream) { return; }
+    if (retiring.valid()) { retiring.wait(); } //only ever one in flight, scene swaps are rare
+    retiring = std::async(std::launch::async, [scene = std::move(scene), level = std::move(level)]() mutable
+    {
+        scene.reset();
+        level = {};
+    });
+}
+
+void SceneManager::Update(const float& dt)
+{
+    SwapIfReady();
+    if (current) { current->Update(dt); }
+}
+
+void SceneManager::Snapshot(RenderFrame& frame)
+{
+    if (current) { current->Snapshot(frame); }
+}
+
+std::string SceneManager::DebugText()
+{
+    if (!current) { return Loading() ? "loading...\n" : ""; }
+    return current->DebugText();
+}
+
+void SceneManager::ShrinkMemory()
+{
+    if (current) { current->ShrinkMemory(); }
+}
+
+void SceneManager::Clean()
+{
+    if (pending.valid()) { pending.wait(); pending = {}; }
+    if (retiring.valid()) { retiring.wait(); retiring = {}; }
+    current.reset();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include "Scenes.hpp"
+
+//owns the running scene and builds the next one on a background thread
+//the finished scene is swapped in at the start of a frame, the old one is freed off the main thread
+class SceneManager
+{
+    private:
+        static std::unique_ptr<Scene> current;
+        static std::future<std::unique_ptr<Scene>> pending;
+        static std::future<void> retiring; //old scene being torn down, joined before the next one or in Clean
+
+        static void SwapIfReady();
+        static void Retire(std::unique_ptr<Scene> scene, LevelSystem::LevelData level);
+
+    public:
+        //start building S, the current scene keeps running until it's done
+        //only one load at a time, false if one is already going
+        template<typename S>
+        static bool LoadAsync()
+        {
+            if (pending.valid()) { return false; } //replacing it would block until it finished
+            std::unique_ptr<Scene> scene = std::make_unique<S>(); //made here, it copies main thread state
+            pending = std::async(std::launch::async, [scene = std::move(scene)]() mutable
+            {
+                scene->Load();
+                return std::move(scene);
+            });
+            return true;
+        }
+
+        static bool Loading() { return pending.valid(); }
+
+        static void Update(const float& dt);
+        static void Snapshot(RenderFrame& frame);
+        static std::string DebugText();
+        static void ShrinkMemory();
+        static void Clean();
+};
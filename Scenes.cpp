@@ -1,6 +1,8 @@
 #include "Scenes.hpp"
 #include "tile_level_loader/level_system.hpp"
 #include "Comps.hpp"
+#include "Weapons.hpp"
+#include "TextureAtlas.hpp"
 
 using ls = LevelSystem;
 
@@ -9,61 +11,99 @@ void Scene::Update(const float& dt)
     _entMan.Update(dt);
 }
 
-void Scene::Draw(sf::RenderWindow& window)
+void Scene::Snapshot(RenderFrame& frame)
 {
-    _entMan.Draw(window);
+    _entMan.Snapshot(frame);
 }
 
-SafeHouse::SafeHouse()
+std::string Scene::DebugText()
 {
+    auto stats = _entMan.Stats();
+    auto kb = [](size_t bytes) { return std::to_string((bytes + 1023) / 1024) + "KB"; };
+
+    std::string text = "entities " + std::to_string(stats.entities) + "  map " + kb(stats.entityBytes) +
+        "  free ids " + std::to_string(stats.freeIds) + " (" + kb(stats.freeIdBytes) + ")\n";
+    size_t total = stats.entityBytes + stats.freeIdBytes;
+    for (auto& pool : stats.pools)
+    {
+        if (pool.highWater == 0) { continue; } //never used
+        text += std::string(pool.name) + "  " + std::to_string(pool.live) + "/" + std::to_string(pool.capacity) +
+            "  peak " + std::to_string(pool.highWater) + "  " + kb(pool.bytes) + "\n";
+        total += pool.bytes;
+    }
+    text += "registry total " + kb(total) + "\n";
+    return text;
+}
+
+LevelSystem::LevelData Scene::Activate()
+{
+    if (!_level.tiles && !_level.stream) { return {}; }
+    ls::commit(_level);
+    return std::move(_level);
+}
+
+void SafeHouse::Load()
+{
+    _level = ls::load_level_data("res/levels/td_1.txt", 50, _look);
+    _entMan.EnablePhysics(Params::useBox2D);
+    auto invaders = TextureAtlas::Register("res/img/invaders_sheet.png", {32, 32}, 8);
+
     //add other components to the player
     auto player = _entMan.CreateEntity();
-    _entMan.add<RenderHitboxes>(player, RenderHitboxes{sf::Color::White});
     _entMan.add<PlayerMovement>(player, PlayerMovement{100});
     _entMan.add<Position>(player, Position{sf::Vector2f(300,300)});
     _entMan.add<Velocity>(player, Velocity{sf::Vector2f(0,0)});
     _entMan.add<Friction>(player, Friction{20});
     _entMan.add<Health>(player, {3, friendly});
     _entMan.add<CircleCollider>(player, CircleCollider{30});
+    _entMan.add<Sprite>(player, Sprite{invaders, TextureAtlas::Cell(invaders, 13), {60, 60}, 1});
+    _entMan.add<Camera>(player, {});
 
-    WeaponArsenal playerArsenal;
+    Weapon shotgun;
+    shotgun.bulletRadius = 10;
+    shotgun.bulletSpeed = 200;
+    shotgun.bulletsShot = 5;
+    shotgun.speedVariation = 100;
+    shotgun.bulletLifetime = 100;
+    shotgun.bulletSpread = 45;
+    shotgun.damage = 1;
+    shotgun.hitMask = CollisionLayer::enemy;
+    shotgun.fireRate = 2;
+    shotgun.pierce = 0;
 
-    playerArsenal.weapons.push_back(Weapon{});
-    playerArsenal.weapons[0].bulletRadius = 10;
-    playerArsenal.weapons[0].bulletSpeed = 200;
-    playerArsenal.weapons[0].bulletsShot = 5;
-    playerArsenal.weapons[0].speedVariation = 100;
-    playerArsenal.weapons[0].bulletLifetime = 100;
-    playerArsenal.weapons[0].bulletSpread = 45;
-    playerArsenal.weapons[0].damage = 1;
-    playerArsenal.weapons[0].dGroup = damageGroup::enemy;
-    playerArsenal.weapons[0].fireRate = 2;
-    playerArsenal.weapons[0].pierce = 0;
+    Weapon cannon;
+    cannon.bulletRadius = 20;
+    cannon.bulletSpeed = 100;
+    cannon.bulletsShot = 1;
+    cannon.bulletLifetime = 1;
+    cannon.damage = 1;
+    cannon.hitMask = CollisionLayer::enemy;
+    cannon.fireRate = 10;
+    cannon.pierce = 0;
 
-    playerArsenal.weapons.push_back(Weapon{});
-    playerArsenal.weapons[1].bulletRadius = 20;
-    playerArsenal.weapons[1].bulletSpeed = 100;
-    playerArsenal.weapons[1].bulletsShot = 1;
-    playerArsenal.weapons[1].bulletLifetime = 1;
-    playerArsenal.weapons[1].damage = 1;
-    playerArsenal.weapons[1].dGroup = damageGroup::enemy;
-    playerArsenal.weapons[1].fireRate = 10;
-    playerArsenal.weapons[1].pierce = 0;
+    WeaponArsenal playerArsenal;
+    playerArsenal.Add(WeaponLibrary::Register("player shotgun", shotgun));
+    playerArsenal.Add(WeaponLibrary::Register("player cannon", cannon));
 
     _entMan.add<WeaponArsenal>(player, playerArsenal);
     _entMan.add<PlayerWeaponLogic>(player,{});
 
     //test enemy
     auto enemy = _entMan.CreateEntity();
-    _entMan.add<RenderHitboxes>(enemy, RenderHitboxes{sf::Color::White});
     _entMan.add<Position>(enemy, Position{sf::Vector2f(500,300)});
     _entMan.add<Velocity>(enemy, Velocity{sf::Vector2f(0,0)});
     _entMan.add<Friction>(enemy, Friction{20});
     _entMan.add<CircleCollider>(enemy, CircleCollider{30});
-    _entMan.add<Health>(enemy, {10, damageGroup::enemy});
-    _entMan.add<EnemySafeMove>(enemy, EnemySafeMove{player, true, 50, {100, 400}});
-    playerArsenal.weapons[0].dGroup = damageGroup::friendly;
-    playerArsenal.weapons[1].dGroup = damageGroup::friendly;
-    _entMan.add<WeaponArsenal>(enemy, playerArsenal);
-    _entMan.add<EnemyShootingLogic>(enemy, EnemyShootingLogic{0.5f, player});
+    _entMan.add<Sprite>(enemy, Sprite{invaders, TextureAtlas::Cell(invaders, 0), {60, 60}});
+    _entMan.add<Health>(enemy, {10, CollisionLayer::enemy});
+    _entMan.SetTarget(enemy, player);
+    _entMan.add<EnemySafeMove>(enemy, EnemySafeMove{true, 50, {100, 400}});
+    shotgun.hitMask = CollisionLayer::friendly;
+    cannon.hitMask = CollisionLayer::friendly;
+    WeaponArsenal enemyArsenal;
+    enemyArsenal.Add(WeaponLibrary::Register("enemy shotgun", shotgun));
+    enemyArsenal.Add(WeaponLibrary::Register("enemy cannon", cannon));
+    _entMan.add<WeaponArsenal>(enemy, enemyArsenal);
+    _entMan.add<EnemyShootingLogic>(enemy, EnemyShootingLogic{0.5f});
+    _entMan.add<AILod>(enemy, {});
 }
\ No newline at end of file
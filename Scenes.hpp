@@ -2,20 +2,36 @@
 
 #include <box2d/box2d.h>
 #include "Systems.hpp"
+#include "tile_level_loader/level_system.hpp"
 #include <unordered_map>
+#include <string>
 
 class Scene
 {
     protected:
         EntityManager _entMan;
+        LevelSystem::LevelData _level; //staged by Load(), goes live in Activate()
+        LevelSystem::Look _look; //what Load() builds the level with, copied when the scene is made
     public:
-        Scene() = default;
+        //scenes are made on the main thread, even when they load on another
+        Scene() : _look(LevelSystem::get_look()) {}
+        virtual ~Scene() = default;
+
+        //builds the scene, runs on the loader thread so it must only touch its own data
+        virtual void Load() {}
+        //called on the main thread when the scene is swapped in, returns the level it replaced
+        LevelSystem::LevelData Activate();
+
         virtual void Update(const float& dt);
-        virtual void Draw(sf::RenderWindow& window);
+        virtual void Snapshot(RenderFrame& frame);
+
+        //pool memory and entity counts for the debug overlay
+        std::string DebugText();
+        void ShrinkMemory() { _entMan.ShrinkToFit(); }
 };
 
 class SafeHouse : public Scene
 {
     public:
-        SafeHouse();
-};
\ No newline at end of file
+        void Load() override;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using Entity = uint32_t;
+
+//uniform grid of entity positions over the world, rebuilt every frame
+//a counting sort keeps each cell's entities next to each other, so a query only
+//walks the cells its rectangle covers and never looks at anything else
+//positions outside the bounds are kept in the nearest edge cell
+//the grid only spans the part of the world that has entities in it, so a huge
+//level doesn't mean a huge grid
+class SpatialGrid
+{
+    public:
+        float cellSize = 128.f; //smallest cell, they grow when entities are spread thin
+
+        template<typename PosT>
+        void Build(const sf::FloatRect& worldBounds, const std::vector<Entity>& ents, const std::vector<PosT>& positions)
+        {
+            bounds = Extent(worldBounds, positions);
+            //at most a few cells per entity, past that empty cells only cost memory and clearing
+            float maxCells = (float)std::max<size_t>(1024, ents.size() * 4);
+            cell = std::max(cellSize, std::sqrt(bounds.width * bounds.height / maxCells));
+            cols = std::max(1, (int)std::ceil(bounds.width / cell));
+            rows = std::max(1, (int)std::ceil(bounds.height / cell));
+            cellStart.assign((size_t)cols * rows + 1, 0);
+            cellOf.resize(ents.size());
+            entries.resize(ents.size());
+
+            //count, prefix sum, then scatter
+            for (size_t i = 0; i < ents.size(); i++)
+            {
+                cellOf[i] = CellIndex(positions[i].pos);
+                cellStart[cellOf[i] + 1]++;
+            }
+            for (size_t c = 1; c < cellStart.size(); c++) { cellStart[c] += cellStart[c - 1]; }
+            fill.assign(cellStart.begin(), cellStart.end() - 1);
+            for (size_t i = 0; i < ents.size(); i++)
+            {
+                entries[fill[cellOf[i]]++] = ents[i];
+            }
+        }
+
+        //calls fn(ent) for every entity whose cell touches the rectangle
+        template<typename F>
+        void Query(const sf::FloatRect& rect, F&& fn) const
+        {
+            if (entries.empty()) { return; }
+            int x0 = Col(rect.left), x1 = Col(rect.left + rect.width);
+            int y0 = Row(rect.top), y1 = Row(rect.top + rect.height);
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    size_t c = (size_t)y * cols + x;
+                    for (uint32_t i = cellStart[c]; i < cellStart[c + 1]; i++) { fn(entries[i]); }
+                }
+            }
+        }
+
+    private:
+        sf::FloatRect bounds;
+        float cell = 128.f; //cell size this build picked
+        int cols = 0;
+        int rows = 0;
+        std::vector<uint32_t> cellStart; //entries of cell c are [cellStart[c], cellStart[c+1])
+        std::vector<uint32_t> cellOf;
+        std::vector<uint32_t> fill;
+        std::vector<Entity> entries;
+
+        int Col(float x) const { return std::clamp((int)std::floor((x - bounds.left) / cell), 0, cols - 1); }
+        int Row(float y) const { return std::clamp((int)std::floor((y - bounds.top) / cell), 0, rows - 1); }
+
+        //box around every position, within the world
+        template<typename PosT>
+        static sf::FloatRect Extent(const sf::FloatRect& world, const std::vector<PosT>& positions)
+        {
+            if (positions.empty()) { return world; }
+            float right = world.left + world.width, bottom = world.top + world.height;
+            float x0 = right, y0 = bottom, x1 = world.left, y1 = world.top;
+            for (auto& p : positions)
+            {
+                x0 = std::min(x0, p.pos.x); y0 = std::min(y0, p.pos.y);
+                x1 = std::max(x1, p.pos.x); y1 = std::max(y1, p.pos.y);
+            }
+            x0 = std::clamp(x0, world.left, right); x1 = std::clamp(x1, world.left, right);
+            y0 = std::clamp(y0, world.top, bottom); y1 = std::clamp(y1, world.top, bottom);
+            if (x1 < x0 || y1 < y0) { return world; }
+            return sf::FloatRect(x0, y0, x1 - x0, y1 - y0);
+        }
+        uint32_t CellIndex(sf::Vector2f p) const { return (uint32_t)(Row(p.y) * cols + Col(p.x)); }
+};
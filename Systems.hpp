@@ -5,41 +5,270 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "gameParams.hpp"
+#include "tile_level_loader/flow_field.hpp"
+#include "tile_level_loader/line_of_sight.hpp"
+#include "PhysicsSys.hpp"
+#include "AIScheduler.hpp"
+#include "Weapons.hpp"
+#include "RenderPipeline.hpp"
+#include "SpatialGrid.hpp"
+#include "Narrowphase.hpp"
+#include "TimerWheel.hpp"
 
 class EntityManager : public Registry
 {
     public:
+        void EnablePhysics(bool enable)
+        {
+            if (!enable) { physics.reset(); return; }
+            if (physics) { return; }
+            physics = std::make_unique<PhysicsSys>();
+            physics->AddExisting(*this);
+        }
+
         void Update(const float &dt)
         {
+            time += dt;
+            ExpireBullets();
+            if (LevelSystem::is_streamed()) { StreamLevel(); }
+            UpdateFlowFields();
+            if (physics) { physics->Update(*this, dt); }
+            if (!physics) { HandleBulletColls(); } //box2d handles bullet hits itself
+            aiScheduler.BeginFrame();
+            CheckLineOfSight();
+            ThinkDeferred();
             for (auto ent : entToBit)
             {
                 auto curEnt = ent.first;
                 
-                HandleVelocity(curEnt, dt);
+                if (!physics) //box2d integrates, collides and handles bullet hits itself
+                {
+                    HandleVelocity(curEnt, dt);
+                    HandleTileCollision(curEnt);
+                }
                 HandleFriction(curEnt, dt);
                 HandlePlayerMovement(curEnt);
                 HandlePlayerWeapons(curEnt);
-                ShootDelay(curEnt, dt);
-                BulletLifeTime(curEnt, dt);
                 HandleHealth(curEnt);
-                HandleBulletColls(curEnt);
-                HandleEnemySafeMove(curEnt);
-                HandleEnemyShooting(curEnt, dt);
+                bool think = AIThinkDue(curEnt);
+                HandleEnemySafeMove(curEnt, think);
+                HandleEnemyShooting(curEnt, think);
             }
             HandleCreationAndDestruction();
+            auto& positions = storage<Position>();
+            grid.Build(WorldBounds(), positions.indexToEntity, positions.data);
+            UpdateCamera();
         }
 
-        void Draw(sf::RenderWindow &window)
+        //copy what needs drawing into the frame, the render thread never touches the registry
+        //only entities in grid cells near the view are looked at
+        void Snapshot(RenderFrame &frame)
         {
-            for (auto ent : entToBit)
+            frame.view = view;
+            sf::FloatRect visible(view.getCenter() - view.getSize() / 2.f, view.getSize());
+            visible.left -= cullMargin;
+            visible.top -= cullMargin;
+            visible.width += cullMargin * 2;
+            visible.height += cullMargin * 2;
+            grid.Query(visible, [&](Entity curEnt)
             {
-                auto curEnt = ent.first;
-                DrawHitboxes(window, curEnt);
-            }
+                SnapshotSprite(frame, curEnt);
+                SnapshotHitboxes(frame, curEnt);
+            });
+        }
+
+        const sf::View& View() const { return view; }
+
+        //the level if there is one, otherwise the screen
+        sf::FloatRect WorldBounds() const
+        {
+            if (LevelSystem::get_width() == 0) { return sf::FloatRect(0, 0, (float)Params::gameW, (float)Params::gameH); }
+            return LevelSystem::get_bounds();
         }
 
     private:
+        std::unique_ptr<PhysicsSys> physics; //null unless box2d is enabled
+        AIScheduler aiScheduler;
+        double time = 0; //game time, weapon cooldowns are stored against it, double so long sessions keep sub-frame precision
+        static constexpr float timerTicksPerSecond = 60;
+        TimerWheel bulletTimers; //bullet expiry, nothing counts lifetimes down each frame
+
+        //whole wheel ticks a lifetime lasts, at least one, capped at what the wheel can hold
+        static TimerWheel::Tick LifetimeTicks(float seconds)
+        {
+            double ticks = std::ceil((double)seconds * timerTicksPerSecond);
+            if (!(ticks >= 1)) { return 1; }
+            return ticks >= (double)TimerWheel::horizon ? TimerWheel::horizon : (TimerWheel::Tick)ticks;
+        }
+        struct CachedFlowField
+        {
+            FlowField field;
+            unsigned int lastUsed; //aiScheduler frame it was last asked for a direction
+        };
+        std::unordered_map<uint64_t, CachedFlowField> flowFields; //one field per chased target (and lane mode)
+        static constexpr unsigned int flowFieldIdleFrames = 300; //dropped after this long unasked, far enemies ask every 16
+        SpatialGrid grid; //every Position, rebuilt at the end of each update
+
+        struct BulletHit
+        {
+            Entity bullet;
+            Entity target;
+        };
+        CirclePairBatch bulletPairs;
+        std::vector<BulletHit> bulletCandidates; //same order as bulletPairs
+        std::vector<uint32_t> bulletOverlaps; //indices of the candidates that actually touch
+        std::unordered_set<uint64_t> bulletContacts, lastBulletContacts; //touching pairs, a hit only counts when they first touch
+        float maxBulletRadius = 0; //biggest bullet ever shot, widens the broadphase query
+        sf::View view{sf::FloatRect(0, 0, (float)Params::gameW, (float)Params::gameH)};
+        static constexpr float cullMargin = 128; //biggest sprite/circle half size that won't pop at the screen edge
+
+        void UpdateCamera()
+        {
+            auto& cams = storage<Camera>();
+            if (cams.data.empty()) { return; }
+            Entity ent = cams.indexToEntity[0];
+            if (!has<Position>(ent)) { return; }
+
+            //follow, but don't show past the edge of a world bigger than the view
+            auto size = cams.data[0].size;
+            auto world = WorldBounds();
+            auto centre = get<Position>(ent)->pos;
+            auto clampAxis = [](float c, float half, float lo, float len)
+            {
+                if (len <= half * 2) { return lo + len / 2; }
+                return std::clamp(c, lo + half, lo + len - half);
+            };
+            centre.x = clampAxis(centre.x, size.x / 2, world.left, world.width);
+            centre.y = clampAxis(centre.y, size.y / 2, world.top, world.height);
+            view.setSize(size);
+            view.setCenter(centre);
+        }
+
+        static uint64_t FlowKey(Entity target, bool lanes)
+        {
+            return (uint64_t)target << 1 | (uint64_t)lanes;
+        }
+
+        LineOfSight lineOfSight;
+        std::vector<std::pair<size_t, size_t>> sightQueries; //EnemyShootingLogic pool index, query
+
+        //every shooter that may decide this frame asks whether it can see its target, all in one batch
+        //the rest keep their old answer, nothing looks at it until they decide again
+        //most pairs of tiles repeat from frame to frame so they come out of the cache
+        void CheckLineOfSight()
+        {
+            auto& shooters = storage<EnemyShootingLogic>();
+            if (LevelSystem::get_width() == 0)
+            {
+                for (auto& shooter : shooters.data) { shooter.targetVisible = true; }
+                return;
+            }
+
+            lineOfSight.clear();
+            sightQueries.clear();
+            for (size_t i = 0; i < shooters.data.size(); i++)
+            {
+                Entity ent = shooters.indexToEntity[i];
+                if (!AIThinkMayBeDue(ent)) { continue; }
+                auto pos = get<Position>(ent);
+                auto target = TargetPos(ent);
+                if (!pos || !target)
+                {
+                    shooters.data[i].targetVisible = false;
+                    continue;
+                }
+                sightQueries.push_back({i, lineOfSight.add(pos->pos, target->pos)});
+            }
+            lineOfSight.run();
+            for (auto [i, query] : sightQueries) { shooters.data[i].targetVisible = lineOfSight.visible(query); }
+        }
+
+        std::vector<LevelSystem::StreamPoint> streamPoints;
+        static constexpr float streamLookAhead = 0.5f; //seconds of movement to have loaded in front of things
+
+        //keep the level loaded around the camera and everything that walks around on its own,
+        //and along where they're heading, so chunks come in before anything gets there
+        void StreamLevel()
+        {
+            streamPoints.clear();
+            auto size = view.getSize();
+            float tile = LevelSystem::get_tile_size();
+            auto& cams = storage<Camera>();
+            sf::Vector2f camVel = cams.data.empty() ? sf::Vector2f(0, 0) : VelocityOf(cams.indexToEntity[0]);
+            AddStreamPath(view.getCenter(), camVel, std::sqrt(size.x * size.x + size.y * size.y) / 2 + tile);
+            auto addActors = [&](const std::vector<Entity>& ents)
+            {
+                for (auto ent : ents)
+                {
+                    auto pos = get<Position>(ent);
+                    if (pos) { AddStreamPath(pos->pos, VelocityOf(ent), tile * 2); }
+                }
+            };
+            addActors(storage<PlayerMovement>().indexToEntity);
+            addActors(storage<EnemySafeMove>().indexToEntity);
+            LevelSystem::stream_around(streamPoints);
+        }
+
+        sf::Vector2f VelocityOf(Entity ent)
+        {
+            auto vel = get<Velocity>(ent);
+            return vel ? vel->vel : sf::Vector2f(0, 0);
+        }
+
+        //circles from pos to where vel takes it in streamLookAhead, spaced so they overlap
+        //no further than a few radii, so something flung across the map can't ask for all of it
+        void AddStreamPath(sf::Vector2f pos, sf::Vector2f vel, float radius)
+        {
+            constexpr int maxSteps = 4;
+            streamPoints.push_back({pos, radius});
+            auto ahead = vel * streamLookAhead;
+            float dist = std::sqrt(ahead.x * ahead.x + ahead.y * ahead.y);
+            if (dist > radius * maxSteps) { ahead *= radius * maxSteps / dist; }
+            int steps = std::min(maxSteps, (int)std::ceil(dist / radius));
+            for (int i = 1; i <= steps; i++) { streamPoints.push_back({pos + ahead * ((float)i / steps), radius}); }
+        }
+
+        void UpdateFlowFields()
+        {
+            //rebuild fields whose target changed tile, drop ones nobody can chase or has chased for a while
+            for (auto it = flowFields.begin(); it != flowFields.end();)
+            {
+                Entity target = (Entity)(it->first >> 1);
+                if (!has<Position>(target) || aiScheduler.Frame() - it->second.lastUsed > flowFieldIdleFrames)
+                {
+                    it = flowFields.erase(it);
+                    continue;
+                }
+                it->second.field.update(get<Position>(target)->pos);
+                ++it;
+            }
+        }
+
+        sf::Vector2f FlowDirection(const EnemySafeMove &enemyMove, Entity target, sf::Vector2f from, sf::Vector2f targetPos)
+        {
+            if (LevelSystem::get_width() == 0) { return {0, 0}; }
+            auto key = FlowKey(target, enemyMove.followLanes);
+            auto it = flowFields.find(key);
+            if (it == flowFields.end())
+            {
+                auto costs = enemyMove.followLanes ? FlowField::lane_costs() : FlowField::open_costs();
+                it = flowFields.emplace(key, CachedFlowField{FlowField(costs), 0}).first;
+                it->second.field.update(targetPos);
+            }
+            it->second.lastUsed = aiScheduler.Frame();
+            return it->second.field.direction_at(from);
+        }
+
+        //position of the entity's target, null if it has none or it's gone
+        Position* TargetPos(Entity ent)
+        {
+            auto target = get<Target>(ent);
+            if (!target) { return nullptr; }
+            return resolve(target->pos);
+        }
+
         void HandleVelocity(Entity ent, const float &dt)
         {
             if (has<Position, Velocity>(ent))
@@ -48,6 +277,74 @@ class EntityManager : public Registry
             }
         }
 
+        void HandleTileCollision(Entity ent)
+        {
+            if (!has<CircleCollider, Position>(ent)) { return; }
+            if (LevelSystem::get_width() == 0) { return; }
+
+            //only the cells the circle's bounding box covers
+            auto pos = &get<Position>(ent)->pos;
+            float r = (float)get<CircleCollider>(ent)->radius;
+            float ts = LevelSystem::get_tile_size();
+            auto minCell = LevelSystem::get_grid_position(*pos - sf::Vector2f(r, r));
+            auto maxCell = LevelSystem::get_grid_position(*pos + sf::Vector2f(r, r));
+            bool isBullet = has<Bullet>(ent);
+
+            for (int y = minCell.y; y <= maxCell.y; y++)
+            {
+                for (int x = minCell.x; x <= maxCell.x; x++)
+                {
+                    //outside the level is open, ClampToWorld handles the edges
+                    if (!LevelSystem::is_solid(LevelSystem::get_tile_or({x, y}, LevelSystem::EMPTY))) { continue; }
+
+                    //closest point on the tile to the circle centre
+                    auto tl = LevelSystem::get_tile_position({x, y});
+                    sf::Vector2f closest(std::clamp(pos->x, tl.x, tl.x + ts), std::clamp(pos->y, tl.y, tl.y + ts));
+                    sf::Vector2f diff = *pos - closest;
+                    float distSq = diff.x * diff.x + diff.y * diff.y;
+                    if (distSq >= r * r) { continue; }
+
+                    //bullets just die on walls
+                    if (isBullet)
+                    {
+                        Destroy(ent);
+                        return;
+                    }
+
+                    //push out along the contact normal
+                    sf::Vector2f normal;
+                    float depth;
+                    if (distSq > 0)
+                    {
+                        float dist = std::sqrt(distSq);
+                        normal = diff / dist;
+                        depth = r - dist;
+                    }
+                    else
+                    {
+                        //centre is inside the tile, leave through the nearest edge
+                        float left = pos->x - tl.x, right = tl.x + ts - pos->x;
+                        float top = pos->y - tl.y, bottom = tl.y + ts - pos->y;
+                        float m = std::min({left, right, top, bottom});
+                        if (m == left) { normal = {-1, 0}; }
+                        else if (m == right) { normal = {1, 0}; }
+                        else if (m == top) { normal = {0, -1}; }
+                        else { normal = {0, 1}; }
+                        depth = m + r;
+                    }
+                    *pos += normal * depth;
+
+                    //stop moving into the wall, keep sliding along it
+                    if (has<Velocity>(ent))
+                    {
+                        auto vel = &get<Velocity>(ent)->vel;
+                        float into = vel->x * normal.x + vel->y * normal.y;
+                        if (into < 0) { *vel -= normal * into; }
+                    }
+                }
+            }
+        }
+
         void HandleFriction(Entity ent, const float &dt)
         {
             if (has<Velocity, Friction>(ent))
@@ -57,22 +354,20 @@ class EntityManager : public Registry
             }
         }
 
-        void DrawHitboxes(sf::RenderWindow &window, Entity ent)
+        void SnapshotHitboxes(RenderFrame &frame, Entity ent)
         {
             if (has<CircleCollider, RenderHitboxes, Position>(ent))
             {
-                auto collider = get<CircleCollider>(ent);
-                auto pos = get<Position>(ent);
-                auto render = get<RenderHitboxes>(ent);
-
-                sf::CircleShape cir;
-                cir.setRadius(collider->radius);
-                cir.setPosition(pos->pos);
-                cir.setOrigin(sf::Vector2f(cir.getRadius(), cir.getRadius()));
-                cir.setFillColor(render->col);
+                frame.circles.push_back(RenderCircle{get<Position>(ent)->pos, (float)get<CircleCollider>(ent)->radius, get<RenderHitboxes>(ent)->col});
+            }
+        }
 
-                auto curPos = cir.getPosition();
-                window.draw(cir);
+        void SnapshotSprite(RenderFrame &frame, Entity ent)
+        {
+            if (has<Sprite, Position>(ent))
+            {
+                auto spr = get<Sprite>(ent);
+                frame.sprites.push_back(RenderSprite{get<Position>(ent)->pos, spr->size, spr->rect, spr->tint, spr->atlas, spr->layer});
             }
         }
 
@@ -80,8 +375,8 @@ class EntityManager : public Registry
         {
             if (has<PlayerMovement, Velocity, Position>(ent))
             {
-                //clamp movement to screen
-                ClampToScreen(ent);
+                //clamp movement to the world
+                ClampToWorld(ent);
                 sf::Vector2f dir = {0,0};
 
                 // Basic WASD / Arrow movement input
@@ -118,21 +413,23 @@ class EntityManager : public Registry
                 else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num3)) { arsenal->selected  = 2; }
                 else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num4)) { arsenal->selected  = 3; }
 
-                arsenal->selected = std::min(arsenal->selected, (int)arsenal->weapons.size()-1);
+                arsenal->selected = std::min(arsenal->selected, arsenal->count-1);
 
                 //shootgun
                 if (!sf::Mouse::isButtonPressed(sf::Mouse::Left)) { return; }
-                auto weapon = &arsenal->weapons[arsenal->selected]; 
-                auto mousePos = MouseHelper::GetMousePos();
+                auto mousePos = MouseHelper::GetMouseWorldPos(view);
                 auto pos = get<Position>(ent);
-                Shoot(weapon, (sf::Vector2f)mousePos, pos->pos);
+                Shoot(arsenal, mousePos, pos->pos);
             }
         }
 
-        bool Shoot(Weapon* weapon, sf::Vector2f target, sf::Vector2f spawnPos, int range = -1)//-1 means doesn't care
+        //fires the arsenal's selected weapon
+        bool Shoot(WeaponArsenal* arsenal, sf::Vector2f target, sf::Vector2f spawnPos, int range = -1)//-1 means doesn't care
         {
+            if (arsenal->selected < 0 || arsenal->selected >= arsenal->count) { return false; }
+            if (time < arsenal->readyAt[arsenal->selected]) { return false; }
+            auto weapon = &WeaponLibrary::Get(arsenal->weapons[arsenal->selected]);
             if (weapon->bulletRadius <= 0) { return false; } //to prevent non defined weapons from shooting
-            if (weapon->fireDelay > 0) { return false; }
 
             auto dir = target - spawnPos;
             auto magnitude = std::sqrt(dir.x * dir.x + dir.y * dir.y);
@@ -143,7 +440,8 @@ class EntityManager : public Registry
             {
                 auto curBullet = CreateEntity();
                 add<Position>(curBullet, Position{spawnPos});
-                add<Bullet>(curBullet, Bullet{weapon->damage, weapon->pierce, weapon->dGroup, weapon->bulletLifetime});
+                auto expireTick = bulletTimers.Schedule(bulletTimers.Current() + LifetimeTicks(weapon->bulletLifetime), curBullet);
+                add<Bullet>(curBullet, Bullet{weapon->damage, weapon->pierce, weapon->hitMask, expireTick});
                 auto newAngle = (std::atan2f(dir.y, dir.x)*180/M_PI + (rand() % (weapon->bulletSpread+1) - weapon->bulletSpread/2))*M_PI/180;
                 auto newDir = sf::Vector2f(std::cosf(newAngle), std::sinf(newAngle));
 
@@ -151,25 +449,22 @@ class EntityManager : public Registry
                 add<CircleCollider>(curBullet, {weapon->bulletRadius});
                 //this is added for testing purposes
                 sf::Color col = sf::Color::Red;
-                if (weapon->dGroup == enemy) { col = sf::Color::Green; }
+                if (weapon->hitMask & enemy) { col = sf::Color::Green; }
                 add<RenderHitboxes>(curBullet, RenderHitboxes{col});
             }
-            weapon->fireDelay = 1.f/weapon->fireRate;
+            maxBulletRadius = std::max(maxBulletRadius, (float)weapon->bulletRadius);
+            arsenal->readyAt[arsenal->selected] = time + 1.0/weapon->fireRate;
             return true;
         }
     
-        void BulletLifeTime(Entity ent, const float &dt)
+        void ExpireBullets()
         {
-            if (has<Bullet>(ent))
+            bulletTimers.Advance((TimerWheel::Tick)(time * timerTicksPerSecond), [this](Entity ent, TimerWheel::Tick due)
             {
+                //the bullet may have died already and its id been reused
                 auto bul = get<Bullet>(ent);
-                bul->lifeTime -= dt;
-
-                if (bul->lifeTime <= 0)
-                {
-                    Destroy(ent);
-                }
-            }
+                if (bul && bul->expireTick == due) { Destroy(ent); }
+            });
         }
 
         void HandleHealth(Entity ent)
@@ -184,65 +479,141 @@ class EntityManager : public Registry
             }
         }
 
-        void HandleBulletColls(Entity ent)
+        //runs before anything moves, so the grid built at the end of the last update is still accurate
+        //broadphase: bullets in grid cells around each damageable entity whose mask matches its layer
+        //narrowphase: all candidate pairs tested together, then the hits are applied in one pass
+        void HandleBulletColls()
         {
-            if (has<Bullet>(ent)){return;}
-            if (!has<Health, CircleCollider, Position>(ent)){return;}
-            auto bullets = getAllEnt<Bullet>();
-            auto eCol = get<CircleCollider>(ent);
-            auto eHP = get<Health>(ent);
-            auto ePos = get<Position>(ent);
-            for (auto curBul : bullets)
+            bulletPairs.Clear();
+            bulletCandidates.clear();
+            bulletOverlaps.clear();
+
+            auto& healths = storage<Health>();
+            for (size_t i = 0; i < healths.data.size(); i++)
             {
-                if (!has<CircleCollider, Position>(curBul)){continue;}
-                auto bul = get<Bullet>(curBul);
-                if (bul->dGroup != eHP->dGroup){continue;}
-                auto dist = ePos->pos - get<Position>(curBul)->pos;
-                if (std::sqrt(dist.x * dist.x + dist.y * dist.y) > (eCol->radius + get<CircleCollider>(curBul)->radius)){continue;;}
-                eHP->hp -= bul->damage;
-                Destroy(curBul);
-                
+                Entity ent = healths.indexToEntity[i];
+                if (has<Bullet>(ent)) { continue; }
+                if (!has<CircleCollider, Position>(ent)) { continue; }
+                LayerMask layer = healths.data[i].layer;
+                auto ePos = get<Position>(ent)->pos;
+                float eRad = (float)get<CircleCollider>(ent)->radius;
+                float reach = eRad + maxBulletRadius;
+                grid.Query(sf::FloatRect(ePos.x - reach, ePos.y - reach, reach * 2, reach * 2), [&](Entity curBul)
+                {
+                    auto bul = get<Bullet>(curBul);
+                    if (!bul || !(bul->mask & layer)) { return; }
+                    auto bPos = get<Position>(curBul);
+                    auto bCol = get<CircleCollider>(curBul);
+                    if (!bPos || !bCol) { return; }
+                    bulletPairs.Add(ePos.x, ePos.y, bPos->pos.x, bPos->pos.y, eRad + bCol->radius);
+                    bulletCandidates.push_back(BulletHit{curBul, ent});
+                });
+            }
+            bulletPairs.Overlapping(bulletOverlaps);
+
+            //a piercing bullet stays inside what it hit for a few frames, only the first counts
+            std::swap(bulletContacts, lastBulletContacts);
+            bulletContacts.clear();
+            for (auto idx : bulletOverlaps)
+            {
+                auto& hit = bulletCandidates[idx];
+                auto bul = get<Bullet>(hit.bullet);
+                if (bul->pierce < 0) { continue; } //used up on an earlier hit this pass
+                uint64_t pair = (uint64_t)hit.bullet << 32 | hit.target;
+                bulletContacts.insert(pair);
+                if (lastBulletContacts.contains(pair)) { continue; }
+                get<Health>(hit.target)->hp -= bul->damage;
+                if (bul->pierce-- == 0) { Destroy(hit.bullet); }
             }
         }
 
-        void ShootDelay(Entity ent, const float &dt)
+        //whether AIThinkDue or ThinkDeferred could let this entity decide this frame, without
+        //changing anything, some of these still get pushed to the next frame by the budget
+        bool AIThinkMayBeDue(Entity ent)
         {
-            if(has<WeaponArsenal>(ent))
+            auto lod = get<AILod>(ent);
+            return !lod || lod->pending || aiScheduler.Scheduled(ent, lod->targetDist);
+        }
+
+        //whether this entity makes its AI decisions this frame, entities without AILod always do
+        bool AIThinkDue(Entity ent)
+        {
+            if (!has<AILod>(ent)) { return has<EnemySafeMove>(ent) || has<EnemyShootingLogic>(ent); }
+            auto lod = get<AILod>(ent);
+            if (lod->lastThink == aiScheduler.Frame()) { return false; } //already handled in ThinkDeferred
+            if (!lod->pending && !aiScheduler.Scheduled(ent, lod->targetDist)) { return false; }
+            if (aiScheduler.OverBudget())
             {
-                auto arsenal = get<WeaponArsenal>(ent);
+                if (!lod->pending) { aiScheduler.Defer(ent); }
+                lod->pending = true;
+                return false;
+            }
+            lod->pending = false;
+            lod->lastThink = aiScheduler.Frame();
+            return true;
+        }
 
-                for (int i = 0; i < (int)arsenal->weapons.size(); i++)
+        //decisions that didn't fit in last frame's budget go before anything else
+        void ThinkDeferred()
+        {
+            for (auto ent : aiScheduler.Retry())
+            {
+                if (!has<AILod>(ent)) { continue; }
+                auto lod = get<AILod>(ent);
+                if (aiScheduler.OverBudget())
                 {
-                    auto weapon = &arsenal->weapons[i];
-                    if (weapon->fireDelay <= 0) {continue;}
-                    weapon->fireDelay = std::max(0.f, weapon->fireDelay - dt);
+                    aiScheduler.Defer(ent);
+                    continue;
                 }
+                lod->pending = false;
+                lod->lastThink = aiScheduler.Frame();
+                if (has<EnemySafeMove, WeaponArsenal, Velocity, Position>(ent))
+                {
+                    aiScheduler.Think([&]{ get<EnemySafeMove>(ent)->moveDir = DecideEnemyMove(ent); });
+                }
+                HandleEnemyShooting(ent, true);
             }
         }
-    
-        void HandleEnemySafeMove(Entity ent)
+
+        //direction to move in until the next decision, zero to stand still
+        sf::Vector2f DecideEnemyMove(Entity ent)
+        {
+            auto enemyMove = get<EnemySafeMove>(ent);
+            auto targetComp = TargetPos(ent);
+            if (!targetComp){return {0, 0};}
+
+            auto targetPos = targetComp->pos;
+            auto pos = get<Position>(ent)->pos;
+            sf::Vector2f dir = targetPos - pos;
+            float dist = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+            if (has<AILod>(ent)) { get<AILod>(ent)->targetDist = dist; }
+
+            if (dist <= enemyMove->range[get<WeaponArsenal>(ent)->selected]) {return {0, 0};}
+
+            //follow the flow field around walls, straight line if there's no path (or no level)
+            auto pathDir = FlowDirection(*enemyMove, get<Target>(ent)->pos.ent, pos, targetPos);
+            if (pathDir.x != 0 || pathDir.y != 0) { return pathDir; }
+            return dir / dist;
+        }
+
+        void HandleEnemySafeMove(Entity ent, bool think)
         {
             if (!has<EnemySafeMove, WeaponArsenal, Velocity, Position>(ent)){return;}
+            auto enemyMove = get<EnemySafeMove>(ent);
+            if (think) { aiScheduler.Think([&]{ enemyMove->moveDir = DecideEnemyMove(ent); }); }
+
             if (has<EnemyShootingLogic>(ent))
             {
-                if(get<EnemyShootingLogic>(ent)->moveTimer > 0) {return;}
+                if (time < get<EnemyShootingLogic>(ent)->moveUntil) {return;}
             }
-            //clamp movement to screen
-            ClampToScreen(ent);
-            auto enemyMove = get<EnemySafeMove>(ent);
-            if (!Exists(enemyMove->target)){return;}
-
-            auto vel = get<Velocity>(ent);
-
-            sf::Vector2f dir = get<Position>(enemyMove->target)->pos - get<Position>(ent)->pos;
-            float dist = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+            //clamp movement to the world
+            ClampToWorld(ent);
 
-            if (dist <= enemyMove->range[get<WeaponArsenal>(ent)->selected]) {return;}
-            dir /= dist;
-            vel->vel += dir * (float)enemyMove->moveSpd;
+            //cheap part, runs every frame with the last decision
+            get<Velocity>(ent)->vel += enemyMove->moveDir * (float)enemyMove->moveSpd;
         }
 
-        void ClampToScreen(Entity ent)
+        void ClampToWorld(Entity ent)
         {
             if (!has<Position>(ent)){return;}
 
@@ -253,17 +624,30 @@ class EntityManager : public Registry
             }
 
             auto pos = get<Position>(ent);
-            pos->pos.x = std::clamp(pos->pos.x, offest, (float)Params::gameW-offest);
-            pos->pos.y = std::clamp(pos->pos.y, offest, (float)Params::gameH-offest);
+            auto world = WorldBounds();
+            pos->pos.x = std::clamp(pos->pos.x, world.left + offest, world.left + world.width - offest);
+            pos->pos.y = std::clamp(pos->pos.y, world.top + offest, world.top + world.height - offest);
         }
     
-        void HandleEnemyShooting(Entity ent, const float& dt)
+        void HandleEnemyShooting(Entity ent, bool think)
         {
+            if (!think) {return;}
             if (!has<Position, EnemyShootingLogic, WeaponArsenal>(ent)){return;}
             auto shootLog = get<EnemyShootingLogic>(ent);
-            if (shootLog->moveTimer > 0) {shootLog->moveTimer -= dt;}
-            if (!Exists(shootLog->target)) {return;}
-            if (!has<Position>(shootLog->target)){return;}
+            aiScheduler.Think([&]{ DecideEnemyShot(ent, shootLog); });
+        }
+
+        void DecideEnemyShot(Entity ent, EnemyShootingLogic* shootLog)
+        {
+            auto targetComp = TargetPos(ent);
+            if (!targetComp) {return;}
+            auto targetPos = targetComp->pos;
+            if (!has<EnemySafeMove>(ent) && has<AILod>(ent)) //nothing else measures the distance
+            {
+                auto diff = targetPos - get<Position>(ent)->pos;
+                get<AILod>(ent)->targetDist = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+            }
+            if (!shootLog->targetVisible) {return;} //don't shoot through walls
             auto weaponArse = get<WeaponArsenal>(ent);
             int range = -1;
             if (has<EnemySafeMove>(ent))
@@ -271,10 +655,10 @@ class EntityManager : public Registry
                 auto sigma = get<EnemySafeMove>(ent)->range[weaponArse->selected];
                 range = get<EnemySafeMove>(ent)->range[weaponArse->selected];
             }
-            if (Shoot(&weaponArse->weapons[weaponArse->selected], get<Position>(shootLog->target)->pos, get<Position>(ent)->pos, range))
+            if (Shoot(weaponArse, targetPos, get<Position>(ent)->pos, range))
             {
                 if (shootLog->moveDelay <= 0){return;}
-                shootLog->moveTimer = shootLog->moveDelay;
+                shootLog->moveUntil = time + shootLog->moveDelay;
             }
             
         }
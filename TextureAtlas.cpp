@@ -0,0 +1,22 @@
+#include "TextureAtlas.hpp"
+
+std::array<TextureAtlas::Info, TextureAtlas::maxAtlases> TextureAtlas::infos;
+std::atomic<int> TextureAtlas::count = 0;
+std::mutex TextureAtlas::registerMutex;
+
+AtlasId TextureAtlas::Register(const std::string& path, sf::Vector2i cellSize, int columns)
+{
+    std::lock_guard<std::mutex> lock(registerMutex);
+    int n = count.load(std::memory_order_relaxed);
+    for (int i = 0; i < n; i++)
+    {
+        if (infos[i].path == path) { return (AtlasId)i; }
+    }
+    if (n == maxAtlases)
+    {
+        throw std::string("Too many texture atlases, can't register: ") + path;
+    }
+    infos[n] = Info{path, cellSize, columns};
+    count.store(n + 1, std::memory_order_release);
+    return (AtlasId)n;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "Comps.hpp"
+
+//sprite sheets cut into equal cells, sprites only hold an id and a rect into one
+//registering just records the path and layout, the texture itself is loaded by the
+//render thread the first time it draws from it, so scenes can register while loading
+class TextureAtlas
+{
+    public:
+        static constexpr int maxAtlases = 32;
+
+        struct Info
+        {
+            std::string path;
+            sf::Vector2i cellSize;
+            int columns;
+        };
+
+        //returns the existing id if this path was already registered
+        static AtlasId Register(const std::string& path, sf::Vector2i cellSize, int columns);
+        static const Info& Get(AtlasId id) { return infos[id]; }
+
+        //texture rect of a cell, counted left to right then top to bottom
+        static sf::IntRect Cell(AtlasId id, int index)
+        {
+            auto& info = infos[id];
+            return sf::IntRect((index % info.columns) * info.cellSize.x, (index / info.columns) * info.cellSize.y,
+                info.cellSize.x, info.cellSize.y);
+        }
+
+    private:
+        static std::array<Info, maxAtlases> infos;
+        static std::atomic<int> count; //published after the slot is written
+        static std::mutex registerMutex;
+};
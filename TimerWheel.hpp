@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using Entity = uint32_t;
+
+//hierarchical timing wheel, timers cost nothing until the tick they're due
+//level 0 has a slot per tick for the next 256 ticks, each level above covers 256x more
+//and its slots are poured into the levels below when the wheel reaches them
+//so scheduling is O(1) and each timer is touched at most once per level
+class TimerWheel
+{
+    public:
+        using Tick = uint64_t;
+        static constexpr int slotBits = 8;
+        static constexpr int slots = 1 << slotBits;
+        static constexpr int levels = 4; //2^32 ticks ahead, further out gets clamped
+        static constexpr Tick horizon = ((Tick)1 << (slotBits * levels)) - 1; //furthest a timer can be from now
+
+        struct Timer
+        {
+            Tick due;
+            Entity ent;
+        };
+
+        //past or current ticks are fired on the next advance, ones past the horizon at it
+        //returns the tick the timer will actually fire with, which is what to check it against
+        Tick Schedule(Tick due, Entity ent)
+        {
+            if (due <= current) { due = current + 1; }
+            if (due - current > horizon) { due = current + horizon; }
+            Insert(Timer{due, ent});
+            return due;
+        }
+
+        //runs every tick up to now, calling fire(ent, due) for each timer that comes due
+        template<typename F>
+        void Advance(Tick now, F&& fire)
+        {
+            while (current < now)
+            {
+                current++;
+                //refill from the top so a timer can drop several levels in one tick
+                for (int level = levels - 1; level > 0; level--)
+                {
+                    if (current & (((Tick)1 << (slotBits * level)) - 1)) { continue; }
+                    auto& slot = wheel[level][Slot(current, level)];
+                    cascade.swap(slot);
+                    for (auto& t : cascade) { Insert(t); }
+                    cascade.clear();
+                }
+
+                auto& slot = wheel[0][Slot(current, 0)];
+                if (slot.empty()) { continue; }
+                firing.swap(slot);
+                for (auto& t : firing) { fire(t.ent, t.due); }
+                firing.clear();
+            }
+        }
+
+        Tick Current() const { return current; }
+
+    private:
+        std::array<std::array<std::vector<Timer>, slots>, levels> wheel;
+        std::vector<Timer> cascade; //reused so refills and firing don't allocate
+        std::vector<Timer> firing;
+        Tick current = 0; //last tick processed
+
+        static size_t Slot(Tick tick, int level) { return (size_t)(tick >> (slotBits * level)) & (slots - 1); }
+
+        void Insert(const Timer& t)
+        {
+            Tick delta = t.due - current;
+            for (int level = 0; level < levels; level++) //Schedule keeps delta inside the top level
+            {
+                if (delta < ((Tick)1 << (slotBits * (level + 1))))
+                {
+                    wheel[level][Slot(t.due, level)].push_back(t);
+                    return;
+                }
+            }
+        }
+};
@@ -0,0 +1,24 @@
+#include "Weapons.hpp"
+
+std::array<Weapon, WeaponLibrary::maxWeapons> WeaponLibrary::defs;
+std::array<std::string, WeaponLibrary::maxWeapons> WeaponLibrary::names;
+std::atomic<int> WeaponLibrary::count = 0;
+std::mutex WeaponLibrary::registerMutex;
+
+WeaponId WeaponLibrary::Register(const std::string& name, const Weapon& def)
+{
+    std::lock_guard<std::mutex> lock(registerMutex);
+    int n = count.load(std::memory_order_relaxed);
+    for (int i = 0; i < n; i++)
+    {
+        if (names[i] == name) { return (WeaponId)i; }
+    }
+    if (n == maxWeapons)
+    {
+        throw std::string("Too many weapon definitions, can't register: ") + name;
+    }
+    defs[n] = def;
+    names[n] = name;
+    count.store(n + 1, std::memory_order_release);
+    return (WeaponId)n;
+}
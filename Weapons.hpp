@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "Comps.hpp"
+
+//every weapon definition lives here once, arsenals only hold ids into it
+//definitions never change or move after registering, so references stay valid
+//and scenes loading on another thread can register while the game reads
+class WeaponLibrary
+{
+    public:
+        static constexpr int maxWeapons = 256;
+
+        //returns the existing id if a weapon with this name was already registered
+        static WeaponId Register(const std::string& name, const Weapon& def);
+        static const Weapon& Get(WeaponId id) { return defs[id]; }
+
+    private:
+        static std::array<Weapon, maxWeapons> defs;
+        static std::array<std::string, maxWeapons> names;
+        static std::atomic<int> count; //published after the slot is written
+        static std::mutex registerMutex;
+};
@@ -0,0 +1,420 @@
+//headless gameplay scenarios for catching performance regressions
+//each scenario is a scene that runs a fixed number of fixed-dt ticks, tick times are
+//compared against bench/baselines.txt and the exit code is non-zero if any got slower
+//or has no baseline, or if a scenario's own check fails
+//baselines are absolute times from one machine, so ctest runs this with --checks-only
+//and only the checks can fail it there, configure with SCENARIO_TIMINGS=ON for the timing gate
+//usage: scenarios [--ticks N] [--baselines path] [--update] [--only name] [--checks-only]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scenes.hpp"
+#include "Weapons.hpp"
+#include "tile_level_loader/level_system.hpp"
+
+#ifndef BENCH_BASELINES
+#define BENCH_BASELINES "bench/baselines.txt"
+#endif
+
+using ls = LevelSystem;
+
+namespace
+{
+    constexpr float tickDt = 1.f / 60.f;
+
+    //allowed slowdown over the baseline before it counts as a regression
+    constexpr double meanTolerance = 1.25;
+    constexpr double p99Tolerance = 1.5;
+
+    //scenes get to script things between ticks and report their size
+    class BenchScene : public Scene
+    {
+        public:
+            virtual void Script(int) {}
+            //checked after the run, a false fails it like a regression
+            virtual bool Check() { return true; }
+            //called after each tick, outside the timing
+            virtual void AfterTick() {}
+            size_t EntityCount() const { return _entMan.EntityCount(); }
+            void Tick(int tick)
+            {
+                Script(tick);
+                Update(tickDt);
+            }
+    };
+
+    Entity AddDummy(EntityManager& em, sf::Vector2f pos, LayerMask layer, int hp)
+    {
+        auto ent = em.CreateEntity();
+        em.add<Position>(ent, Position{pos});
+        em.add<Velocity>(ent, Velocity{{0, 0}});
+        em.add<CircleCollider>(ent, CircleCollider{30});
+        em.add<Health>(ent, Health{hp, layer});
+        return ent;
+    }
+
+    //20 turrets spraying shotgun pellets that live for 100s, peaks around 10k bullets
+    class ShotgunSpam : public BenchScene
+    {
+        public:
+            void Load() override
+            {
+                Weapon shotgun;
+                shotgun.bulletRadius = 10;
+                shotgun.bulletSpeed = 50;
+                shotgun.bulletsShot = 5;
+                shotgun.speedVariation = 20;
+                shotgun.bulletLifetime = 100;
+                shotgun.bulletSpread = 90;
+                shotgun.damage = 1;
+                shotgun.hitMask = CollisionLayer::friendly;
+                shotgun.fireRate = 12;
+                auto gun = WeaponLibrary::Register("bench shotgun", shotgun);
+
+                auto target = AddDummy(_entMan, {400, 300}, friendly, 1000000000);
+                for (int i = 0; i < 20; i++)
+                {
+                    auto turret = _entMan.CreateEntity();
+                    _entMan.add<Position>(turret, Position{sf::Vector2f(40.f * i, 0)});
+                    WeaponArsenal arsenal;
+                    arsenal.Add(gun);
+                    _entMan.add<WeaponArsenal>(turret, arsenal);
+                    _entMan.SetTarget(turret, target);
+                    _entMan.add<EnemyShootingLogic>(turret, EnemyShootingLogic{0});
+                }
+            }
+    };
+
+    //1000 chasers after a target running in circles
+    class Chasers : public BenchScene
+    {
+        public:
+            void Load() override
+            {
+                Weapon none; //bulletRadius 0, never fires
+                auto unarmed = WeaponLibrary::Register("bench unarmed", none);
+
+                target = AddDummy(_entMan, {400, 300}, friendly, 1);
+                for (int i = 0; i < 1000; i++)
+                {
+                    auto ent = _entMan.CreateEntity();
+                    _entMan.add<Position>(ent, Position{sf::Vector2f((float)(rand() % Params::gameW), (float)(rand() % Params::gameH))});
+                    _entMan.add<Velocity>(ent, Velocity{{0, 0}});
+                    _entMan.add<Friction>(ent, Friction{20});
+                    _entMan.add<CircleCollider>(ent, CircleCollider{5});
+                    WeaponArsenal arsenal;
+                    arsenal.Add(unarmed);
+                    _entMan.add<WeaponArsenal>(ent, arsenal);
+                    _entMan.SetTarget(ent, target);
+                    _entMan.add<EnemySafeMove>(ent, EnemySafeMove{false, 50, {20}});
+                    _entMan.add<AILod>(ent, {});
+                }
+            }
+
+            void Script(int tick) override
+            {
+                auto pos = _entMan.get<Position>(target); //not created until the first update finishes
+                if (!pos) { return; }
+                float a = tick * 0.02f;
+                pos->pos = sf::Vector2f(400 + 250 * std::cos(a), 300 + 200 * std::sin(a));
+            }
+
+        private:
+            Entity target;
+    };
+
+    //maze walls with bouncing balls and chasers pathing around them
+    class MazeWalls : public BenchScene
+    {
+        public:
+            void Load() override
+            {
+                _level = ls::load_level_data("res/levels/maze_2.txt", 100, _look);
+                Weapon none;
+                auto unarmed = WeaponLibrary::Register("bench unarmed", none);
+
+                auto target = AddDummy(_entMan, {650, 350}, friendly, 1);
+                for (int i = 0; i < 500; i++)
+                {
+                    auto ent = _entMan.CreateEntity();
+                    _entMan.add<Position>(ent, Position{sf::Vector2f(150, 150)});
+                    float a = i * 0.37f;
+                    _entMan.add<Velocity>(ent, Velocity{sf::Vector2f(std::cos(a), std::sin(a)) * 200.f});
+                    _entMan.add<CircleCollider>(ent, CircleCollider{8});
+                    if (i % 2 == 0) { continue; }
+                    _entMan.add<Friction>(ent, Friction{20});
+                    WeaponArsenal arsenal;
+                    arsenal.Add(unarmed);
+                    _entMan.add<WeaponArsenal>(ent, arsenal);
+                    _entMan.SetTarget(ent, target);
+                    _entMan.add<EnemySafeMove>(ent, EnemySafeMove{false, 50, {20}});
+                }
+            }
+    };
+
+    //a camera heading across a 2000x2000 streamed map with a few chasers in tow
+    //chunks are loaded and dropped all the way, and never go past the budget
+    //ticks are paced to real time so the loader thread gets the time it would in the game,
+    //and the chunks under the camera and a quarter second ahead of it have to be loaded on
+    //nearly every tick once it's moving
+    class StreamedWalk : public BenchScene
+    {
+        public:
+            static constexpr int mapTiles = 2000;
+            static constexpr float tileSize = 50;
+            static constexpr size_t maxChunks = 32; //the view needs about 16
+
+            void Load() override
+            {
+                //generated once, later runs reuse it and its binary cache
+                const char* path = "bench_streamed.txt";
+                if (!std::filesystem::exists(path))
+                {
+                    std::ofstream f(path);
+                    std::string row(mapTiles, ' ');
+                    for (int y = 0; y < mapTiles; y++)
+                    {
+                        for (int x = 0; x < mapTiles; x++) { row[x] = (x * 7 + y * 13) % 29 == 0 ? 'w' : ' '; }
+                        f << row << "\n";
+                    }
+                }
+                _level = ls::load_level_streamed(path, tileSize, _look, maxChunks);
+
+                Weapon none;
+                auto unarmed = WeaponLibrary::Register("bench unarmed", none);
+                walker = AddDummy(_entMan, Along(0), friendly, 1);
+                _entMan.add<Camera>(walker, {});
+                for (int i = 0; i < 10; i++)
+                {
+                    auto ent = _entMan.CreateEntity();
+                    _entMan.add<Position>(ent, Position{Along(0) + sf::Vector2f(40.f * i, 0)});
+                    _entMan.add<Velocity>(ent, Velocity{{0, 0}});
+                    _entMan.add<Friction>(ent, Friction{20});
+                    _entMan.add<CircleCollider>(ent, CircleCollider{5});
+                    WeaponArsenal arsenal;
+                    arsenal.Add(unarmed);
+                    _entMan.add<WeaponArsenal>(ent, arsenal);
+                    _entMan.SetTarget(ent, walker);
+                    _entMan.add<EnemySafeMove>(ent, EnemySafeMove{false, 200, {20}});
+                }
+            }
+
+            void Script(int tick) override
+            {
+                //what the last tick left loaded
+                constexpr size_t chunkTiles = ls::TileLayer::CHUNK_TILES * ls::TileLayer::CHUNK_TILES;
+                peakChunks = std::max(peakChunks, ls::get_stats().tiles / chunkTiles);
+                auto pos = _entMan.get<Position>(walker); //not created until the first update finishes
+                if (!pos) { return; }
+                if (tick >= warmup)
+                {
+                    auto loaded = [](sf::Vector2f p) { return ls::get_tile_or(ls::get_grid_position(p), ls::TILE_COUNT) != ls::TILE_COUNT; };
+                    watched++;
+                    missedUnderfoot += !loaded(pos->pos);
+                    missedAhead += !loaded(pos->pos + _entMan.get<Velocity>(walker)->vel * 0.25f);
+                }
+                //moved along the path rather than by physics so walls don't stop it,
+                //the velocity says where it's heading so streaming can look ahead
+                pos->pos = Along(tick);
+                _entMan.get<Velocity>(walker)->vel = (Along(tick + 1) - Along(tick)) / tickDt;
+            }
+
+            void AfterTick() override
+            {
+                nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(tickDt));
+                if (nextTick < std::chrono::steady_clock::now()) { nextTick = std::chrono::steady_clock::now(); }
+                std::this_thread::sleep_until(nextTick);
+            }
+
+            bool Check() override
+            {
+                std::cout << "  streamed: peak " << peakChunks << "/" << maxChunks << " chunks, not loaded under the camera on "
+                          << missedUnderfoot << " and a quarter second ahead of it on " << missedAhead << " of " << watched << " ticks\n";
+                return peakChunks > 0 && peakChunks <= maxChunks && watched > 0 &&
+                    missedUnderfoot * 50 <= watched && missedAhead * 50 <= watched;
+            }
+
+        private:
+            static constexpr int warmup = 30; //ticks for the first chunks to come in
+            Entity walker;
+            size_t peakChunks = 0;
+            int watched = 0;
+            int missedUnderfoot = 0; //ticks after the warmup, at most 2% of them may miss
+            int missedAhead = 0;
+            std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+
+            //2500 units a second along the diagonal, about 30 chunks in 600 ticks
+            static sf::Vector2f Along(int tick)
+            {
+                float d = std::min(500 + tick * 2500 * tickDt, mapTiles * tileSize - 500);
+                return sf::Vector2f(d, d);
+            }
+    };
+
+    struct Result
+    {
+        double mean = 0, p50 = 0, p99 = 0, max = 0;
+        size_t peakEntities = 0;
+    };
+
+    Result Run(BenchScene& scene, int ticks)
+    {
+        srand(1); //same spread/speed rolls every run
+        scene.Load();
+        scene.Activate();
+
+        std::vector<double> times;
+        times.reserve(ticks);
+        Result r;
+        for (int t = 0; t < ticks; t++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            scene.Tick(t);
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            r.peakEntities = std::max(r.peakEntities, scene.EntityCount());
+            scene.AfterTick();
+        }
+
+        std::sort(times.begin(), times.end());
+        for (auto t : times) { r.mean += t; }
+        r.mean /= times.size();
+        r.p50 = times[times.size() / 2];
+        r.p99 = times[std::min(times.size() - 1, (size_t)(times.size() * 0.99))];
+        r.max = times.back();
+        return r;
+    }
+
+    //baseline file: one "name mean_ms p99_ms" line per scenario, # starts a comment
+    std::map<std::string, std::pair<double, double>> LoadBaselines(const std::string& path)
+    {
+        std::map<std::string, std::pair<double, double>> baselines;
+        std::ifstream f(path);
+        std::string line;
+        while (std::getline(f, line))
+        {
+            if (line.empty() || line[0] == '#') { continue; }
+            std::istringstream in(line);
+            std::string name;
+            double mean, p99;
+            if (in >> name >> mean >> p99) { baselines[name] = {mean, p99}; }
+        }
+        return baselines;
+    }
+
+    //rewrites the lines of the scenarios that ran, other lines and the comments are kept as they were
+    void SaveBaselines(const std::string& path, const std::map<std::string, Result>& results)
+    {
+        auto row = [](const std::string& name, const Result& r)
+        {
+            std::ostringstream out;
+            out << name << " " << r.mean << " " << r.p99;
+            return out.str();
+        };
+        std::vector<std::string> lines;
+        std::map<std::string, Result> pending = results;
+        {
+            std::ifstream f(path);
+            std::string line;
+            while (std::getline(f, line))
+            {
+                std::string name;
+                std::istringstream(line) >> name;
+                auto it = line.empty() || line[0] == '#' ? pending.end() : pending.find(name);
+                if (it != pending.end())
+                {
+                    line = row(name, it->second);
+                    pending.erase(it);
+                }
+                lines.push_back(line);
+            }
+        }
+        if (lines.empty()) { lines.push_back("# scenario mean_ms p99_ms, written by scenarios --update"); }
+        for (auto& [name, r] : pending) { lines.push_back(row(name, r)); }
+
+        std::ofstream f(path);
+        for (auto& line : lines) { f << line << "\n"; }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int ticks = 600;
+    std::string baselinePath = BENCH_BASELINES;
+    std::string only;
+    bool update = false;
+    bool checksOnly = false; //timings are printed but can't fail the run
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--ticks" && i + 1 < argc) { ticks = std::max(1, std::atoi(argv[++i])); }
+        else if (arg == "--baselines" && i + 1 < argc) { baselinePath = argv[++i]; }
+        else if (arg == "--only" && i + 1 < argc) { only = argv[++i]; }
+        else if (arg == "--update") { update = true; }
+        else if (arg == "--checks-only") { checksOnly = true; }
+    }
+
+    std::vector<std::pair<std::string, std::function<std::unique_ptr<BenchScene>()>>> scenarios = {
+        {"shotgun_spam", []{ return std::make_unique<ShotgunSpam>(); }},
+        {"chasers", []{ return std::make_unique<Chasers>(); }},
+        {"maze_walls", []{ return std::make_unique<MazeWalls>(); }},
+        {"streamed_walk", []{ return std::make_unique<StreamedWalk>(); }},
+    };
+
+    auto baselines = LoadBaselines(baselinePath);
+    std::map<std::string, Result> results;
+    bool regressed = false;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(14) << "scenario" << " mean_ms   p50_ms   p99_ms   max_ms  peak_ents\n";
+    for (auto& [name, make] : scenarios)
+    {
+        if (!only.empty() && only != name) { continue; }
+        auto scene = make();
+        auto r = Run(*scene, ticks);
+        results[name] = r;
+
+        std::cout << std::left << std::setw(14) << name << " " << std::right
+                  << std::setw(8) << r.mean << " " << std::setw(8) << r.p50 << " "
+                  << std::setw(8) << r.p99 << " " << std::setw(8) << r.max << " " << std::setw(10) << r.peakEntities;
+
+        auto it = baselines.find(name);
+        if (it == baselines.end())
+        {
+            //a scenario nobody recorded can't pass, or deleting its line would silence it
+            regressed |= !update && !checksOnly;
+            std::cout << "  (no baseline)\n";
+        }
+        else
+        {
+            bool slow = r.mean > it->second.first * meanTolerance || r.p99 > it->second.second * p99Tolerance;
+            regressed |= slow && !checksOnly;
+            std::cout << (slow ? "  REGRESSION vs " : "  ok vs ") << it->second.first << "/" << it->second.second << "\n";
+        }
+
+        if (!scene->Check())
+        {
+            std::cout << "CHECK FAILED: " << name << "\n";
+            regressed = true;
+        }
+    }
+
+    if (update)
+    {
+        SaveBaselines(baselinePath, results);
+        std::cout << "Baselines written to " << baselinePath << "\n";
+        return 0;
+    }
+    return regressed ? 1 : 0;
+}
@@ -5,4 +5,5 @@ struct Params
     static constexpr int gameW = 800;
     static constexpr int gameH = 600;
     static constexpr int b2ScaleFactor = 32;
+    static constexpr bool useBox2D = false; //move and collide circle entities with box2d instead of the ecs systems
 };
\ No newline at end of file
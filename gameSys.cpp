@@ -8,57 +8,64 @@
 #include "gameSys.hpp"
 #include "gameParams.hpp"
 #include "Systems.hpp"
-#include "Scenes.hpp"
+#include "SceneManager.hpp"
 #include "tile_level_loader/level_system.hpp"
 
 using ls = LevelSystem;
 
-enum Screen
-{
-    other,
-    ts  
-};
-
-SafeHouse sfScene;
-
-Screen curScreen;
+bool showStats = false; //F3
+std::string statsText; //rebuilt a few times a second, not every frame
+sf::Clock statsClock;
 
 void GameSys::init()
 {
-    sfScene = SafeHouse();
-    curScreen = ts;
     ls::set_color(ls::EMPTY, sf::Color(10, 10, 30));
     ls::set_color(ls::WALL, sf::Color(60, 60, 80));
     ls::set_color(ls::WAYPOINT, sf::Color(120, 120, 120));
     ls::set_color(ls::START, sf::Color(80, 255, 80));
     ls::set_color(ls::END, sf::Color(255, 80, 80));
-    ls::get_height();
-    ls::get_width();
-    ls::load_level("res/levels/td_1.txt", 50);
+    SceneManager::LoadAsync<SafeHouse>();
 }
 
 void GameSys::update(const float &dt) 
 {
-    switch (curScreen)
+    SceneManager::Update(dt);
+}
+
+void GameSys::snapshot(RenderFrame &frame) 
+{
+    frame.tiles = ls::get_tile_layer();
+    SceneManager::Snapshot(frame);
+
+    if (!showStats) { return; }
+    if (statsText.empty() || statsClock.getElapsedTime().asSeconds() > 0.25f)
     {
-        case ts:
-            sfScene.Update(dt);
-            break;
+        statsClock.restart();
+        auto level = ls::get_stats();
+        statsText = SceneManager::DebugText() +
+            "level " + std::to_string(ls::get_width()) + "x" + std::to_string(ls::get_height()) +
+            "  tiles " + std::to_string(level.tile_bytes / 1024) + "KB" +
+            "  vertices " + std::to_string(level.vertex_bytes / 1024) + "KB\n" +
+            "F3 hide  F4 shrink pools";
     }
+    frame.overlay = statsText;
 }
 
-void GameSys::render(sf::RenderWindow &window) 
+void GameSys::keyPressed(sf::Keyboard::Key key)
 {
-    ls::render(window);
-    switch (curScreen)
+    if (key == sf::Keyboard::F3)
+    {
+        showStats = !showStats;
+        statsText.clear();
+    }
+    else if (key == sf::Keyboard::F4)
     {
-        case ts:
-            sfScene.Draw(window);
-            break;
+        SceneManager::ShrinkMemory();
+        statsText.clear();
     }
 }
 
 void GameSys::clean()
 {
-	
+	SceneManager::Clean();
 }
\ No newline at end of file
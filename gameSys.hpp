@@ -3,11 +3,13 @@
 #include <SFML/Graphics.hpp>
 #include <memory>
 #include <vector>
+#include "RenderPipeline.hpp"
 
 struct GameSys
 {
     static void init();
     static void clean();
     static void update(const float &dt);
-    static void render(sf::RenderWindow &window);
+    static void snapshot(RenderFrame &frame); //fill the frame the render thread will draw
+    static void keyPressed(sf::Keyboard::Key key);
 };
\ No newline at end of file
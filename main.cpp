@@ -7,6 +7,7 @@
 #include "gameParams.hpp"
 #include <tuple>
 #include "MouseHelper.hpp"
+#include "RenderPipeline.hpp"
 
 int test;
 
@@ -22,6 +23,9 @@ int main () {
     //initialise and load
 	GameSys::init();
 
+	//drawing happens on its own thread from here on
+	RenderPipeline pipeline(window);
+
 	while (window.isOpen())
 	{
 		//process window events
@@ -30,18 +34,24 @@ int main () {
 	  	{
       		if (event.type == sf::Event::Closed)
 			{
+				pipeline.Stop();
         		window.close();
       		}
+			else if (event.type == sf::Event::KeyPressed)
+			{
+				GameSys::keyPressed(event.key.code);
+			}
     	}
+		if (!window.isOpen()) { break; }
 
 		//Calculate dt
 		static sf::Clock clock;
 		const float dt = clock.restart().asSeconds();
-		window.clear();
 		GameSys::update(dt);
-		GameSys::render(window);
-		window.display();
+		GameSys::snapshot(pipeline.BeginFrame());
+		pipeline.Submit();
 	}
+	pipeline.Stop();
 
 	//Unload and shutdown
 	GameSys::clean();
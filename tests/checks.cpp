@@ -0,0 +1,116 @@
+//headless correctness checks, no timings, ctest runs it as the "checks" test
+//each check prints what failed and the exit code is non-zero if any did
+//usage: checks
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Scenes.hpp"
+#include "TimerWheel.hpp"
+#include "Weapons.hpp"
+
+namespace
+{
+    bool ok = true;
+
+    void Check(bool pass, const char* what)
+    {
+        if (!pass) { std::cout << "CHECK FAILED: " << what << "\n"; }
+        ok &= pass;
+    }
+
+    //a turret firing for half a second then removed, to see its bullets expire
+    class BulletExpiry : public Scene
+    {
+        public:
+            explicit BulletExpiry(float lifetime) : lifetime(lifetime) {}
+
+            void Load() override
+            {
+                Weapon gun;
+                gun.bulletRadius = 5;
+                gun.bulletSpeed = 10;
+                gun.bulletsShot = 3;
+                gun.bulletLifetime = lifetime;
+                gun.hitMask = CollisionLayer::friendly;
+                gun.fireRate = 20;
+                auto id = WeaponLibrary::Register(lifetime <= 0 ? "check instant" : "check forever", gun);
+
+                auto target = _entMan.CreateEntity();
+                _entMan.add<Position>(target, Position{sf::Vector2f(1000, 0)});
+                _entMan.add<CircleCollider>(target, CircleCollider{30});
+                _entMan.add<Health>(target, Health{1, friendly});
+                turret = _entMan.CreateEntity();
+                _entMan.add<Position>(turret, Position{sf::Vector2f(0, 0)});
+                WeaponArsenal arsenal;
+                arsenal.Add(id);
+                _entMan.add<WeaponArsenal>(turret, arsenal);
+                _entMan.SetTarget(turret, target);
+                _entMan.add<EnemyShootingLogic>(turret, EnemyShootingLogic{0});
+            }
+
+            void Tick(int tick)
+            {
+                if (tick == 30) { _entMan.Destroy(turret); }
+                Update(1.f / 60.f);
+            }
+
+            size_t Bullets()
+            {
+                for (auto& pool : _entMan.Stats().pools)
+                {
+                    if (std::string(pool.name) == "Bullet") { return pool.live; }
+                }
+                return 0;
+            }
+
+        private:
+            float lifetime;
+            Entity turret;
+    };
+
+    //timers due now or beyond the horizon are moved, Schedule says where to
+    void CheckTimerWheel()
+    {
+        TimerWheel wheel;
+        wheel.Advance(10, [](Entity, TimerWheel::Tick) {});
+        auto now = wheel.Schedule(10, 1);
+        auto far = wheel.Schedule(10 + TimerWheel::horizon * 4, 2);
+        Check(now == 11, "a timer due now fires on the next tick");
+        Check(far == 10 + TimerWheel::horizon, "a timer past the horizon is clamped to it");
+        TimerWheel::Tick fired = 0;
+        wheel.Advance(11, [&fired](Entity ent, TimerWheel::Tick due) { if (ent == 1) { fired = due; } });
+        Check(fired == now, "a moved timer fires with the tick Schedule returned");
+    }
+
+    //and through the game: 0 lifetime bullets go within a tick, ones past the horizon stay
+    void CheckBulletExpiry()
+    {
+        for (float lifetime : {0.f, 1e9f})
+        {
+            srand(1);
+            BulletExpiry scene(lifetime);
+            scene.Load();
+            scene.Activate();
+            size_t peak = 0;
+            for (int t = 0; t < 40; t++)
+            {
+                scene.Tick(t);
+                peak = std::max(peak, scene.Bullets());
+            }
+            Check(peak > 0, "the expiry turret fired");
+            if (lifetime <= 0) { Check(scene.Bullets() == 0, "0 lifetime bullets expire"); }
+            else { Check(scene.Bullets() > 0, "bullets past the timer horizon aren't expired early"); }
+        }
+    }
+}
+
+int main()
+{
+    CheckTimerWheel();
+    CheckBulletExpiry();
+    std::cout << (ok ? "all checks passed\n" : "some checks failed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "flow_field.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// -------------------------
+// Cost tables
+// -------------------------
+
+FlowField::CostTable FlowField::open_costs() {
+    CostTable c;
+    c.fill(1);
+    c[LevelSystem::WALL] = 0;
+    return c;
+}
+
+FlowField::CostTable FlowField::lane_costs(uint8_t off_lane) {
+    CostTable c;
+    c.fill(off_lane);
+    c[LevelSystem::WALL] = 0;
+    c[LevelSystem::ENEMY] = 1;
+    c[LevelSystem::WAYPOINT] = 1;
+    c[LevelSystem::START] = 1;
+    c[LevelSystem::END] = 1;
+    return c;
+}
+
+FlowField::FlowField(const CostTable& costs) : _costs(costs) {
+    // One bucket per possible step cost (+1) is enough for Dial's algorithm.
+    const uint8_t max_cost = *std::max_element(_costs.begin(), _costs.end());
+    _buckets.resize(static_cast<size_t>(max_cost) + 1);
+}
+
+// -------------------------
+// Building
+// -------------------------
+
+bool FlowField::update(sf::Vector2f target) {
+    const sf::Vector2i tile = LevelSystem::get_grid_position(target);
+    const bool same_tiles = _level_version == LevelSystem::get_version() &&
+        _resident_version == LevelSystem::get_resident_version();
+    if (tile == _target && same_tiles) {
+        return false;
+    }
+    _level_version = LevelSystem::get_version();
+    _resident_version = LevelSystem::get_resident_version();
+    if (!same_tiles || !window_holds(tile) || !retarget(tile)) {
+        _target = tile;
+        place_window();
+        rebuild();
+    }
+    return true;
+}
+
+void FlowField::place_window() {
+    if (!LevelSystem::is_streamed()) {
+        _origin = { 0, 0 };
+        _width = LevelSystem::_width;
+        _height = LevelSystem::_height;
+        return;
+    }
+    // Clipped to the level, so a window at the map's edge is just smaller
+    const int x0 = std::max(0, _target.x - STREAM_RADIUS);
+    const int y0 = std::max(0, _target.y - STREAM_RADIUS);
+    const int x1 = std::min(LevelSystem::_width - 1, _target.x + STREAM_RADIUS);
+    const int y1 = std::min(LevelSystem::_height - 1, _target.y + STREAM_RADIUS);
+    _origin = { x0, y0 };
+    _window_centre = _target;
+    _width = std::max(0, x1 - x0 + 1);
+    _height = std::max(0, y1 - y0 + 1);
+}
+
+bool FlowField::window_holds(sf::Vector2i tile) const {
+    if (!LevelSystem::is_streamed()) return true;
+    return std::abs(tile.x - _window_centre.x) <= STREAM_RADIUS / 2 &&
+        std::abs(tile.y - _window_centre.y) <= STREAM_RADIUS / 2;
+}
+
+uint8_t FlowField::cost_at(uint32_t i) const {
+    // Streamed levels have no flat array; chunks that aren't loaded count as walls.
+    // A flat level is always covered whole, so its indices line up.
+    const LevelSystem::Tile* tiles = LevelSystem::_tiles.get();
+    if (tiles) return _costs[tiles[i]];
+    const sf::Vector2i grid(static_cast<int>(i % _width) + _origin.x, static_cast<int>(i / _width) + _origin.y);
+    return _costs[LevelSystem::get_tile_or(grid)];
+}
+
+// Dial's algorithm (Dijkstra with a bucket queue): costs are small integers,
+// so each tile is pushed/popped a bounded number of times and the whole
+// build stays linear in the covered area.
+void FlowField::rebuild() {
+    const sf::Vector2i target = local(_target);
+    _valid = in_range(target);
+    if (!_valid) return;
+
+    const size_t count = static_cast<size_t>(_width) * static_cast<size_t>(_height);
+    _dist.assign(count, UNREACHABLE);
+    for (auto& b : _buckets) b.clear();
+
+    // The target tile is always the source, even if an agent stands on
+    // something impassable.
+    const uint32_t start = static_cast<uint32_t>(target.y * _width + target.x);
+    _dist[start] = 0;
+    _buckets[0].push_back(start);
+    propagate(1);
+}
+
+// Moving the target from A to B: every tile can still get to B through A,
+// so its old distance plus the A-B distance is an upper bound that is
+// already a real path. Searching from B and only keeping strict
+// improvements on that bound gives the exact new field, and only touches
+// the tiles that now have a better way to B than through A - in corridors
+// and mazes that's a small part of the level.
+bool FlowField::retarget(sf::Vector2i tile) {
+    const sf::Vector2i a = local(_target);
+    const sf::Vector2i b = local(tile);
+    if (!_valid || !in_range(b)) return false;
+    const uint32_t from = static_cast<uint32_t>(a.y * _width + a.x);
+    const uint32_t to = static_cast<uint32_t>(b.y * _width + b.x);
+
+    // A path from A to B reversed costs the same, less B's own cost plus A's.
+    // If A can't be stepped onto, or B was never reached, start over.
+    const uint8_t cost_from = cost_at(from);
+    if (_dist[to] == UNREACHABLE || cost_from == 0) return false;
+    const uint32_t shift = _dist[to] - cost_at(to) + cost_from;
+
+    for (auto& d : _dist) {
+        if (d != UNREACHABLE) d += shift;
+    }
+    for (auto& b : _buckets) b.clear();
+    _target = tile;
+    _dist[to] = 0;
+    _buckets[0].push_back(to);
+    propagate(1);
+    return true;
+}
+
+void FlowField::propagate(size_t pending) {
+    const uint32_t nb = static_cast<uint32_t>(_buckets.size());
+    for (uint32_t d = 0; pending != 0; ++d) {
+        auto& bucket = _buckets[d % nb];
+        while (!bucket.empty()) {
+            const uint32_t i = bucket.back();
+            bucket.pop_back();
+            --pending;
+            if (_dist[i] != d) continue; // stale entry, already settled cheaper
+
+            const int x = static_cast<int>(i % _width);
+            const int y = static_cast<int>(i / _width);
+            const sf::Vector2i steps[4] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+            for (const auto& s : steps) {
+                if (!in_range(s)) continue;
+                const uint32_t j = static_cast<uint32_t>(s.y * _width + s.x);
+                const uint8_t c = cost_at(j);
+                if (c == 0) continue;
+                const uint32_t nd = d + c;
+                if (nd >= _dist[j]) continue;
+                _dist[j] = nd;
+                _buckets[nd % nb].push_back(j);
+                ++pending;
+            }
+        }
+    }
+}
+
+// -------------------------
+// Sampling
+// -------------------------
+
+sf::Vector2f FlowField::direction_at(sf::Vector2f world) const {
+    const sf::Vector2i p = local(LevelSystem::get_grid_position(world));
+    if (!_valid || !in_range(p) || p == local(_target)) return { 0.f, 0.f };
+    auto dist = [&](int x, int y) {
+        return in_range({ x, y }) ? _dist[y * _width + x] : UNREACHABLE;
+    };
+    if (dist(p.x, p.y) == UNREACHABLE) return { 0.f, 0.f };
+
+    // Pick the cheapest of the 8 neighbours. Diagonals only count when both
+    // adjacent orthogonal tiles are open, so agents don't cut wall corners.
+    sf::Vector2i best = p;
+    uint32_t best_d = dist(p.x, p.y);
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            if (dx == 0 && dy == 0) continue;
+            if (dx != 0 && dy != 0 &&
+                (dist(p.x + dx, p.y) == UNREACHABLE || dist(p.x, p.y + dy) == UNREACHABLE)) {
+                continue;
+            }
+            const uint32_t d = dist(p.x + dx, p.y + dy);
+            if (d < best_d) {
+                best_d = d;
+                best = { p.x + dx, p.y + dy };
+            }
+        }
+    }
+    if (best == p) return { 0.f, 0.f };
+
+    // Steer towards the centre of the next tile rather than along a fixed
+    // compass direction, which keeps agents off the wall edges.
+    const float half = LevelSystem::get_tile_size() * 0.5f;
+    sf::Vector2f dir = LevelSystem::get_tile_position(best + _origin) + sf::Vector2f(half, half) - world;
+    const float len = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+    if (len <= 0.f) return { 0.f, 0.f };
+    return dir / len;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "level_system.hpp"
+
+// Distance field over the LevelSystem grid towards a single target tile.
+// Built once per level (one Dijkstra pass), then repaired when the target
+// moves to another tile; any number of agents can sample a direction from
+// it in constant time. On a streamed level it only covers a window around
+// the target, so its size doesn't grow with the map.
+class FlowField {
+public:
+    // Cost of stepping onto each tile type, 0 = impassable
+    using CostTable = std::array<uint8_t, LevelSystem::TILE_COUNT>;
+
+    // Everything except walls, all at the same cost
+    static CostTable open_costs();
+    // Prefer enemy lanes, waypoints and start/end tiles: every other open
+    // tile costs `off_lane`. 0 makes lanes hard, so only a target standing
+    // on a lane can be reached.
+    static CostTable lane_costs(uint8_t off_lane = 4);
+
+    explicit FlowField(const CostTable& costs = open_costs());
+
+    // Tiles either side of the target a streamed level's field covers. The
+    // window is moved once the target gets half way to its edge.
+    static constexpr int STREAM_RADIUS = 64;
+
+    // Rebuild if the target moved to another tile, the level changed or
+    // (streamed) chunks came in or out. Returns true when it was recomputed.
+    bool update(sf::Vector2f target);
+
+    // Unit vector to steer along from a world position.
+    // Zero if the position is unreachable, outside the field or on the target tile.
+    sf::Vector2f direction_at(sf::Vector2f world) const;
+
+    static constexpr uint32_t UNREACHABLE = UINT32_MAX;
+
+private:
+    void rebuild();
+    // Repair the field for a new target tile, false if it needs a full rebuild
+    bool retarget(sf::Vector2i tile);
+    // Run Dial's queue until it's empty
+    void propagate(size_t pending);
+    // Fit the covered area to the level, or the window around _target
+    void place_window();
+    bool window_holds(sf::Vector2i tile) const;
+    uint8_t cost_at(uint32_t i) const;
+    // Grid coords relative to the covered area, which is what in_range and _dist use
+    sf::Vector2i local(sf::Vector2i grid) const { return grid - _origin; }
+    bool in_range(sf::Vector2i p) const { return p.x >= 0 && p.y >= 0 && p.x < _width && p.y < _height; }
+
+    CostTable _costs;
+    sf::Vector2i _target{ -1, -1 }; // grid coords
+    uint32_t _level_version = 0;
+    uint32_t _resident_version = 0;
+    sf::Vector2i _origin{ 0, 0 };   // grid coords of the covered area's top-left
+    sf::Vector2i _window_centre{ 0, 0 };
+    int _width = 0;                 // covered area, in tiles
+    int _height = 0;
+    bool _valid = false;
+
+    std::vector<uint32_t> _dist;                // row-major over the covered area
+    std::vector<std::vector<uint32_t>> _buckets; // Dial's queue, reused between builds
+};
@@ -1,19 +1,50 @@
 #include "level_system.hpp"
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // -------------------------
 // Static member definitions
 // -------------------------
 
 // Raw tile data for the loaded level, stored in row-major order.
-std::unique_ptr<LevelSystem::Tile[]> LevelSystem::_tiles;
+std::shared_ptr<LevelSystem::Tile[]> LevelSystem::_tiles;
+
+// Chunk store and lookup table when the level is streamed instead.
+std::shared_ptr<LevelSystem::ChunkStream> LevelSystem::_stream;
+const LevelSystem::Tile* const* LevelSystem::_chunk_table = nullptr;
+int LevelSystem::_chunks_x = 0;
 
 // Level dimensions (in tiles).
 int LevelSystem::_width = 0;
 int LevelSystem::_height = 0;
 
+// Incremented whenever a new level is loaded.
+uint32_t LevelSystem::_version = 0;
+
+// Incremented whenever a streamed level loads or drops chunks.
+uint32_t LevelSystem::_resident_version = 0;
+
 // World-space offset for the top-left of the level.
 // Lets us move the whole grid around if needed.
 sf::Vector2f LevelSystem::_offset(0.f, 0.f);
@@ -21,11 +52,13 @@ sf::Vector2f LevelSystem::_offset(0.f, 0.f);
 // Size of a single tile (width/height in pixels).
 float LevelSystem::_tile_size = 100.f;
 
-// Cached world position of the "start" tile (for spawning the player).
+// Grid position of the "start" tile, and its cached world position (for
+// spawning the player).
+sf::Vector2i LevelSystem::_start_tile(0, 0);
 sf::Vector2f LevelSystem::_start_position(0.f, 0.f);
 
-// One drawable rect per tile, built from the tile data.
-std::vector<std::unique_ptr<sf::RectangleShape>> LevelSystem::_sprites;
+// Chunked vertex arrays for the tiles, built from the tile data.
+std::shared_ptr<const LevelSystem::TileLayer> LevelSystem::_tile_layer;
 
 // Colour lookup table for each tile type.
 std::map<LevelSystem::Tile, sf::Color> LevelSystem::_colors{
@@ -44,6 +77,9 @@ std::map<LevelSystem::Tile, sf::Color> LevelSystem::_colors{
 int LevelSystem::get_height() { return _height; }
 int LevelSystem::get_width() { return _width; }
 sf::Vector2f LevelSystem::get_start_position() { return _start_position; }
+float LevelSystem::get_tile_size() { return _tile_size; }
+uint32_t LevelSystem::get_version() { return _version; }
+uint32_t LevelSystem::get_resident_version() { return _resident_version; }
 
 // Look up the colour for a specific tile type.
 sf::Color LevelSystem::get_color(LevelSystem::Tile t) {
@@ -62,13 +98,28 @@ sf::Vector2f LevelSystem::get_tile_position(sf::Vector2i p) {
     return _offset + sf::Vector2f(p.x * _tile_size, p.y * _tile_size);
 }
 
+// Convert from world coordinates (pixels) to grid coordinates.
+// Uses floor so positions left/above the level give negative coords.
+sf::Vector2i LevelSystem::get_grid_position(sf::Vector2f v) {
+    const sf::Vector2f a = (v - _offset) / _tile_size;
+    return { static_cast<int>(std::floor(a.x)), static_cast<int>(std::floor(a.y)) };
+}
+
 // Get the tile type at a specific grid coordinate.
-// Throws if the coordinates are out of range.
+// Throws if the coordinates are out of range, or for a streamed level,
+// if the chunk holding them isn't loaded.
 LevelSystem::Tile LevelSystem::get_tile(sf::Vector2i p) {
     if (p.x < 0 || p.y < 0 || p.x >= _width || p.y >= _height) {
         throw std::string("Tile out of range: ") + std::to_string(p.x) + "," + std::to_string(p.y);
     }
-    return _tiles[(p.y * _width) + p.x];
+    if (_tiles) {
+        return _tiles[(p.y * _width) + p.x];
+    }
+    const Tile* chunk = get_chunk(p);
+    if (!chunk) {
+        throw std::string("Tile not loaded: ") + std::to_string(p.x) + "," + std::to_string(p.y);
+    }
+    return chunk[chunk_offset(p)];
 }
 
 // Get the tile type at a world-space position (pixels).
@@ -84,137 +135,806 @@ LevelSystem::Tile LevelSystem::get_tile_at(sf::Vector2f v) {
 // Sprite building
 // -------------------------
 
-// Build one rectangle sprite per tile so the level can be drawn quickly.
-void LevelSystem::build_sprites() {
-    _sprites.clear();
-    _sprites.reserve(_width * _height);
+// Set up the CHUNK_TILES square chunks a view draws, so it only draws the
+// chunks it overlaps. Their triangles are left for the first draw to build,
+// so a big map doesn't pay for the parts nobody looks at.
+// Works on a staged level, so it's safe to run off the main thread.
+void LevelSystem::build_tile_layer(LevelData& level, const Look& look) {
+    constexpr int CT = TileLayer::CHUNK_TILES;
+    auto layer = std::make_shared<TileLayer>();
+    layer->chunks_x = (level.width + CT - 1) / CT;
+    layer->chunks_y = (level.height + CT - 1) / CT;
+    layer->chunk_size = level.tile_size * CT;
+    layer->offset = look.offset;
+    layer->tiles = level.tiles;
+    layer->width = level.width;
+    layer->height = level.height;
+    layer->tile_size = level.tile_size;
+    layer->palette = look.palette;
+    layer->chunks.resize(static_cast<size_t>(layer->chunks_x) * layer->chunks_y);
+    level.tile_layer = std::move(layer);
+}
 
-    for (int y = 0; y < _height; ++y) {
-        for (int x = 0; x < _width; ++x) {
-            auto rect = std::make_unique<sf::RectangleShape>();
+// Main thread only, it reads the live offset and colours.
+LevelSystem::Look LevelSystem::get_look() {
+    Look look;
+    look.offset = _offset;
+    for (int t = 0; t < TILE_COUNT; ++t) {
+        look.palette[t] = get_color(static_cast<Tile>(t));
+    }
+    return look;
+}
 
-            // Position the rect at the correct world-space tile position.
-            rect->setPosition(get_tile_position({ x, y }));
-            rect->setSize({ _tile_size, _tile_size });
+sf::VertexArray LevelSystem::build_chunk(const Tile* tiles, size_t stride, int x0, int y0, int w, int h, float ts,
+    const Palette& palette, sf::Vector2f offset) {
+    sf::VertexArray chunk(sf::Triangles, static_cast<size_t>(w) * h * 6);
+    size_t v = 0;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            // Corners of the tile in world space.
+            const sf::Vector2f tl = offset + sf::Vector2f((x0 + x) * ts, (y0 + y) * ts);
+            const sf::Vector2f tr = tl + sf::Vector2f(ts, 0.f);
+            const sf::Vector2f br = tl + sf::Vector2f(ts, ts);
+            const sf::Vector2f bl = tl + sf::Vector2f(0.f, ts);
 
             // Pick colour based on the tile type at this grid position.
-            rect->setFillColor(get_color(get_tile({ x, y })));
-
-            _sprites.push_back(std::move(rect));
+            const Tile t = tiles[static_cast<size_t>(y) * stride + x];
+            const sf::Color c = t < TILE_COUNT ? palette[t] : sf::Color::Transparent;
+
+            chunk[v++] = sf::Vertex(tl, c);
+            chunk[v++] = sf::Vertex(tr, c);
+            chunk[v++] = sf::Vertex(br, c);
+            chunk[v++] = sf::Vertex(tl, c);
+            chunk[v++] = sf::Vertex(br, c);
+            chunk[v++] = sf::Vertex(bl, c);
         }
     }
+    return chunk;
 }
 
 // -------------------------
 // Level loading
 // -------------------------
 
-// Load a level from a text file and build tile/sprite data.
+namespace {
+
+// Read-only memory mapping of a whole file. Lets the parser walk the level
+// straight out of the page cache instead of copying it into a string first.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size)) return;
+        _size = static_cast<size_t>(size.QuadPart);
+        _ok = true;
+        if (_size == 0) return;
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (_mapping == nullptr) { _ok = false; return; }
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (_data == nullptr) _ok = false;
+#else
+        _fd = open(path.c_str(), O_RDONLY);
+        if (_fd < 0) return;
+        struct stat st;
+        if (fstat(_fd, &st) != 0) return;
+        _size = static_cast<size_t>(st.st_size);
+        _ok = true;
+        if (_size == 0) return;
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (p == MAP_FAILED) { _ok = false; return; }
+        madvise(p, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const char*>(p);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+        if (_data) munmap(const_cast<char*>(_data), _size);
+        if (_fd >= 0) close(_fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool good() const { return _ok; }
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _ok = false;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
+
+// Character classes used by the text parser. Tile values map 1:1 onto
+// LevelSystem::Tile, the rest are control codes.
+constexpr uint8_t CH_SKIP = 0xFD;    // '\r', ignored
+constexpr uint8_t CH_NEWLINE = 0xFE; // end of row
+constexpr uint8_t CH_UNKNOWN = 0xFF; // not a tile, reported once
+
+constexpr std::array<uint8_t, 256> make_char_table() {
+    std::array<uint8_t, 256> t{};
+    for (auto& c : t) c = CH_UNKNOWN;
+    t[static_cast<uint8_t>('w')] = LevelSystem::WALL;
+    t[static_cast<uint8_t>('s')] = LevelSystem::START;
+    t[static_cast<uint8_t>('e')] = LevelSystem::END;
+    t[static_cast<uint8_t>(' ')] = LevelSystem::EMPTY;
+    t[static_cast<uint8_t>('+')] = LevelSystem::WAYPOINT;
+    t[static_cast<uint8_t>('n')] = LevelSystem::ENEMY;
+    t[static_cast<uint8_t>('\r')] = CH_SKIP;
+    t[static_cast<uint8_t>('\n')] = CH_NEWLINE;
+    return t;
+}
+constexpr std::array<uint8_t, 256> CHAR_TABLE = make_char_table();
+
+inline bool is_tile_char(char c) {
+    return CHAR_TABLE[static_cast<uint8_t>(c)] < CH_SKIP;
+}
+
+// Count tile characters in [begin, end) - used to size a row.
+size_t count_tiles(const char* begin, const char* end) {
+    size_t n = 0;
+    for (const char* p = begin; p != end; ++p) n += is_tile_char(*p);
+    return n;
+}
+
+// Header of the binary level cache. Written in native byte order, it is a
+// local cache rather than an interchange format.
+struct LevelFileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t start_x;
+    int32_t start_y;
+    uint64_t source_size;  // size of the .txt the cache was built from
+    int64_t source_time;   // last write time of that .txt
+};
+
+constexpr char LEVEL_MAGIC[4] = { 'L', 'V', 'L', 'B' };
+constexpr uint32_t LEVEL_VERSION = 1;
+
+// Size and timestamp of the source file, used to check the cache is current.
+bool source_stamp(const std::string& path, uint64_t& size, int64_t& time) {
+    std::error_code ec;
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec) return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+LevelFileHeader make_header(int width, int height, sf::Vector2i start, uint64_t src_size, int64_t src_time) {
+    LevelFileHeader header{};
+    std::memcpy(header.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC));
+    header.version = LEVEL_VERSION;
+    header.width = width;
+    header.height = height;
+    header.start_x = start.x;
+    header.start_y = start.y;
+    header.source_size = src_size;
+    header.source_time = src_time;
+    return header;
+}
+
+void write_level_file(const std::string& path, const LevelFileHeader& header, const void* tiles) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f.good()) {
+        std::cout << "Couldn't write level file: " << path << "\n";
+        return;
+    }
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(static_cast<const char*>(tiles),
+        static_cast<std::streamsize>(static_cast<size_t>(header.width) * static_cast<size_t>(header.height)));
+}
+
+bool read_header(const MappedFile& file, LevelFileHeader& header) {
+    if (!file.good() || file.size() < sizeof(LevelFileHeader)) return false;
+    std::memcpy(&header, file.data(), sizeof(LevelFileHeader));
+    if (std::memcmp(header.magic, LEVEL_MAGIC, sizeof(LEVEL_MAGIC)) != 0) return false;
+    if (header.version != LEVEL_VERSION || header.width < 0 || header.height < 0) return false;
+    const uint64_t count = static_cast<uint64_t>(header.width) * static_cast<uint64_t>(header.height);
+    return file.size() == sizeof(LevelFileHeader) + count;
+}
+
+// Copy the tiles after a header read_header accepted into a staged level.
+void read_tiles(const MappedFile& file, const LevelFileHeader& header, LevelSystem::LevelData& level) {
+    const size_t count = static_cast<size_t>(header.width) * static_cast<size_t>(header.height);
+    level.tiles = std::make_shared<LevelSystem::Tile[]>(count);
+    if (count != 0) {
+        std::memcpy(level.tiles.get(), file.data() + sizeof(LevelFileHeader), count);
+    }
+    level.width = header.width;
+    level.height = header.height;
+    level.start_tile = { header.start_x, header.start_y };
+}
+
+} // namespace
+
+// Reads chunks of a level's binary cache on its own I/O thread. Only the
+// request and finished queues are shared with it; residency, the LRU and
+// the lookup table belong to the main thread.
+class LevelSystem::ChunkStream {
+public:
+    static constexpr int CT = TileLayer::CHUNK_TILES;
+
+    // Keeps its own copy of the look: chunks are built on the I/O thread,
+    // which mustn't read the statics the main thread writes
+    ChunkStream(const std::string& path, int width, int height, float tile_size, size_t max_chunks, const Look& look)
+        : _path(path), _width(width), _height(height), _tile_size(tile_size), _max_chunks(max_chunks),
+          _level_offset(look.offset), _palette(look.palette) {
+        _chunks_x = (width + CT - 1) / CT;
+        _chunks_y = (height + CT - 1) / CT;
+        _table.assign(static_cast<size_t>(_chunks_x) * _chunks_y, nullptr);
+        _thread = std::thread(&ChunkStream::run, this);
+    }
+
+    ~ChunkStream() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _thread.join();
+    }
+
+    ChunkStream(const ChunkStream&) = delete;
+    ChunkStream& operator=(const ChunkStream&) = delete;
+
+    const Tile* const* table() const { return _table.data(); }
+    int chunks_x() const { return _chunks_x; }
+    size_t resident_tiles() const { return _resident.size() * CT * CT; }
+    size_t table_bytes() const { return _table.capacity() * sizeof(const Tile*); }
+
+    // True if any chunk came in or was dropped
+    bool update(const std::vector<StreamPoint>& points);
+
+    // Drawable snapshot of the chunks loaded right now
+    std::shared_ptr<const TileLayer> build_layer() const;
+
+private:
+    struct Loaded {
+        size_t index;
+        std::unique_ptr<Tile[]> tiles;
+        std::shared_ptr<const sf::VertexArray> vertices;
+    };
+    struct Resident {
+        std::unique_ptr<Tile[]> tiles;
+        std::shared_ptr<const sf::VertexArray> vertices;
+        uint64_t last_used;
+    };
+
+    void run();
+    Loaded load(std::ifstream& file, size_t index) const;
+
+    const std::string _path;
+    const int _width;
+    const int _height;
+    const float _tile_size;
+    const size_t _max_chunks;
+    const sf::Vector2f _level_offset;
+    const Palette _palette;
+    int _chunks_x = 0;
+    int _chunks_y = 0;
+
+    // Shared with the I/O thread
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<size_t> _queue;
+    std::vector<Loaded> _finished;
+    bool _stop = false;
+
+    // Main thread only
+    std::vector<const Tile*> _table;
+    std::unordered_map<size_t, Resident> _resident;
+    std::unordered_map<size_t, uint64_t> _requested; // Queued or being read, with the last frame it was wanted
+    uint64_t _frame = 0;
+
+    std::thread _thread; // Last, so everything it uses exists before it starts
+};
+
+// Cache file lives next to the text level with a ".lvl" extension.
+std::string LevelSystem::get_cache_path(const std::string& path) {
+    return std::filesystem::path(path).replace_extension(".lvl").string();
+}
+
+// Swap a staged level in as the live one. `level` gets the previous live
+// level back, so the caller decides where the old data is freed.
+void LevelSystem::commit(LevelData& level) {
+    std::swap(_tiles, level.tiles);
+    std::swap(_width, level.width);
+    std::swap(_height, level.height);
+    std::swap(_tile_size, level.tile_size);
+    std::swap(_start_tile, level.start_tile);
+    std::swap(_tile_layer, level.tile_layer);
+    std::swap(_stream, level.stream);
+    _chunk_table = _stream ? _stream->table() : nullptr;
+    _chunks_x = _stream ? _stream->chunks_x() : 0;
+    _start_position = get_tile_position(_start_tile);
+    ++_version;
+}
+
+// Parse a text level straight into the staged tile array.
 // The file is treated as a grid of characters:
 //   'w' = wall, 's' = start, 'e' = end, ' ' = empty,
 //   '+' = waypoint, 'n' = enemy lane.
 // Newlines mark the end of a row.
-void LevelSystem::load_level(const std::string& path, float tile_size) {
-    _tile_size = tile_size;
-    _width = 0;
-    _height = 0;
-    _start_position = { 0.f, 0.f };
-    _tiles.reset();
-    _sprites.clear();
-
-    // Read whole file into a single string buffer.
-    std::string buffer;
-    std::ifstream f(path);
-    if (f.good()) {
-        f.seekg(0, std::ios::end);
-        buffer.resize(static_cast<size_t>(f.tellg()));
-        f.seekg(0);
-        f.read(&buffer[0], buffer.size());
-        f.close();
-    }
-    else {
-        throw std::string("Couldn't open level file: ") + path;
+// A cheap first pass sizes the grid (width from the first row, height from
+// the newline count) so the second pass can write each tile in place.
+void LevelSystem::parse_level(const char* data, size_t size, LevelData& level) {
+    const char* const end = data + size;
+
+    // Width = tiles on the first row.
+    const char* first_nl = static_cast<const char*>(std::memchr(data, '\n', size));
+    const int w = static_cast<int>(count_tiles(data, first_nl ? first_nl : end));
+
+    // Height = number of newlines, plus the last row if it isn't terminated.
+    int h = 0;
+    const char* last_row = data;
+    for (const char* p = first_nl; p != nullptr;
+        p = static_cast<const char*>(std::memchr(p + 1, '\n', end - p - 1))) {
+        ++h;
+        last_row = p + 1;
     }
-
-    int x = 0;       // current column
-    int w = 0, h = 0; // final width/height in tiles
-    std::vector<Tile> temp; // temporary storage for parsed tiles
-
-    // Parse each character and convert it to a Tile.
-    for (size_t i = 0; i < buffer.size(); ++i) {
-        const char c = buffer[i];
-        switch (c) {
-        case 'w':
-            temp.push_back(WALL);
-            break;
-        case 's':
-            temp.push_back(START);
-            // When we see the start tile, cache its world position.
-            _start_position = get_tile_position({ x, h });
-            break;
-        case 'e':
-            temp.push_back(END);
-            break;
-        case ' ':
-            temp.push_back(EMPTY);
-            break;
-        case '+':
-            temp.push_back(WAYPOINT);
-            break;
-        case 'n':
-            temp.push_back(ENEMY);
-            break;
-
-        case '\r':
-            // Ignore carriage return (Windows line endings).
-            continue;
-
-        case '\n':
-            // End of row.
-            if (w == 0) w = x;  // First newline -> we now know the width.
+    if (count_tiles(last_row, end) != 0) ++h;
+
+    const size_t count = static_cast<size_t>(w) * static_cast<size_t>(h);
+    level.tiles = std::make_shared<Tile[]>(count);
+    Tile* tiles = level.tiles.get();
+
+    size_t n = 0;        // tiles written so far
+    int x = 0, y = 0;    // current column/row
+    size_t unknown = 0;  // characters we skipped
+    char first_unknown = 0;
+
+    for (const char* p = data; p != end; ++p) {
+        const uint8_t t = CHAR_TABLE[static_cast<uint8_t>(*p)];
+        if (t < CH_SKIP) {
+            if (n == count) {
+                throw std::string("Can't parse level file: wrong size (more than ") +
+                    std::to_string(count) + " tiles)";
+            }
+            if (t == START) {
+                // When we see the start tile, cache its grid position.
+                level.start_tile = { x, y };
+            }
+            tiles[n++] = static_cast<Tile>(t);
+            ++x;
+        }
+        else if (t == CH_NEWLINE) {
             x = 0;
-            ++h;
-            continue;
-
-        default:
+            ++y;
+        }
+        else if (t == CH_UNKNOWN) {
             // Anything else is treated as an unknown tile but we don't abort;
-            std::cout << "Unknown tile: '" << c << "'\n";
-            continue;
+            if (unknown++ == 0) first_unknown = *p;
         }
-        ++x;
     }
 
-    // If the last line didn't end with '\n', we still need to count it.
-    if (x != 0) {
-        ++h;
-        if (w == 0) w = x;
+    if (unknown != 0) {
+        std::cout << "Skipped " << unknown << " unknown tile character(s), first: '" << first_unknown << "'\n";
     }
 
     // Check the number of parsed tiles must match width * height.
-    if (static_cast<int>(temp.size()) != w * h) {
+    if (n != count) {
         throw std::string("Can't parse level file: wrong size (") +
-            std::to_string(temp.size()) + " vs " + std::to_string(w * h) + ")";
+            std::to_string(n) + " vs " + std::to_string(count) + ")";
     }
 
-    // Copy the temporary vector into our contiguous tile array.
-    _tiles = std::make_unique<Tile[]>(w * h);
-    _width = w;
-    _height = h;
-    std::copy(temp.begin(), temp.end(), &_tiles[0]);
+    level.width = w;
+    level.height = h;
+}
+
+// Read the binary format into a staged level.
+bool LevelSystem::read_level_binary(const std::string& path, LevelData& level) {
+    MappedFile file(path);
+    LevelFileHeader header;
+    if (!read_header(file, header)) return false;
+    read_tiles(file, header, level);
+    return true;
+}
+
+// Load a level from a text file and set up its tile layer, without
+// touching the live level. Reads no shared state, the look is passed in,
+// so it can run on a loader thread.
+LevelSystem::LevelData LevelSystem::load_level_data(const std::string& path, float tile_size, const Look& look, bool use_cache) {
+    LevelData level;
+    level.tile_size = tile_size;
+
+    const std::string cache = get_cache_path(path);
+    uint64_t src_size = 0;
+    int64_t src_time = 0;
+    const bool stamped = use_cache && source_stamp(path, src_size, src_time);
+
+    // Reuse the binary cache if it was built from this exact text file.
+    bool cached = false;
+    if (stamped) {
+        MappedFile file(cache);
+        LevelFileHeader header;
+        cached = read_header(file, header) && header.source_size == src_size && header.source_time == src_time;
+        if (cached) read_tiles(file, header, level);
+    }
+
+    if (!cached) {
+        {
+            MappedFile file(path);
+            if (!file.good()) {
+                throw std::string("Couldn't open level file: ") + path;
+            }
+            parse_level(file.data(), file.size(), level);
+        }
+
+        // Stamp the cache with the source it came from.
+        if (stamped) {
+            write_level_file(cache, make_header(level.width, level.height, level.start_tile, src_size, src_time),
+                level.tiles.get());
+        }
+    }
 
-    // Build one drawable rect per tile.
-    build_sprites();
-    std::cout << "Level " << path << " Loaded: " << w << "x" << h << "\n";
+    // Build the drawable tile layer.
+    build_tile_layer(level, look);
+    std::cout << "Level " << (cached ? cache : path) << " Loaded: " << level.width << "x" << level.height << "\n";
+    return level;
+}
+
+// Load a level and make it live straight away.
+void LevelSystem::load_level(const std::string& path, float tile_size, bool use_cache) {
+    LevelData level = load_level_data(path, tile_size, get_look(), use_cache);
+    commit(level);
+}
+
+// Load a level previously written by save_level_binary.
+// Returns false (keeping the current level) if the file is missing or invalid.
+bool LevelSystem::load_level_binary(const std::string& path, float tile_size) {
+    LevelData level;
+    level.tile_size = tile_size;
+    if (!read_level_binary(path, level)) return false;
+
+    build_tile_layer(level, get_look());
+    commit(level);
+    std::cout << "Level " << path << " Loaded: " << _width << "x" << _height << "\n";
+    return true;
+}
+
+// Write the current level in the binary format. The source stamp is left
+// zeroed, so a file written this way is never mistaken for a fresh cache.
+void LevelSystem::save_level_binary(const std::string& path) {
+    if (_stream) {
+        throw std::string("Can't save a streamed level, its cache is already the binary file");
+    }
+    write_level_file(path, make_header(_width, _height, _start_tile, 0, 0), _tiles.get());
 }
 
 // -------------------------
 // Rendering
 // -------------------------
 
-// Draw every tile sprite to the window.
-void LevelSystem::render(sf::RenderWindow& window) {
-    const size_t N = static_cast<size_t>(_width) * static_cast<size_t>(_height);
-    for (size_t i = 0; i < N; ++i) {
-        window.draw(*_sprites[i]);
+std::shared_ptr<const LevelSystem::TileLayer> LevelSystem::get_tile_layer() { return _tile_layer; }
+
+sf::FloatRect LevelSystem::get_bounds() {
+    return sf::FloatRect(_offset.x, _offset.y, _width * _tile_size, _height * _tile_size);
+}
+
+// Draw the whole tile layer to a window or texture.
+void LevelSystem::render(sf::RenderTarget& target) {
+    if (_tile_layer) {
+        _tile_layer->draw(target, get_bounds());
+    }
+}
+
+// Only counts the chunks that have been built so far
+size_t LevelSystem::TileLayer::get_vertex_count() const {
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(chunks_mutex);
+        for (const auto& chunk : chunks) {
+            count += chunk.getVertexCount();
+        }
+    }
+    for (const auto& chunk : resident) {
+        count += chunk.vertices->getVertexCount();
+    }
+    return count;
+}
+
+void LevelSystem::TileLayer::draw(sf::RenderTarget& target, const sf::FloatRect& visible) const {
+    // Streamed: only a budget's worth of chunks, so just test each one
+    for (const auto& chunk : resident) {
+        const sf::FloatRect bounds(offset.x + chunk.x * chunk_size, offset.y + chunk.y * chunk_size, chunk_size, chunk_size);
+        if (bounds.intersects(visible)) {
+            target.draw(*chunk.vertices);
+        }
+    }
+    if (chunks.empty()) {
+        return;
+    }
+    // Chunk range the rectangle covers, clamped to the layer
+    const int x0 = std::max(0, static_cast<int>(std::floor((visible.left - offset.x) / chunk_size)));
+    const int y0 = std::max(0, static_cast<int>(std::floor((visible.top - offset.y) / chunk_size)));
+    const int x1 = std::min(chunks_x - 1, static_cast<int>(std::floor((visible.left + visible.width - offset.x) / chunk_size)));
+    const int y1 = std::min(chunks_y - 1, static_cast<int>(std::floor((visible.top + visible.height - offset.y) / chunk_size)));
+    std::lock_guard<std::mutex> lock(chunks_mutex);
+    for (int cy = y0; cy <= y1; ++cy) {
+        for (int cx = x0; cx <= x1; ++cx) {
+            sf::VertexArray& chunk = chunks[static_cast<size_t>(cy) * chunks_x + cx];
+            if (chunk.getVertexCount() == 0) {
+                // First time on screen, same triangles a streamed chunk gets
+                const int tx = cx * CHUNK_TILES;
+                const int ty = cy * CHUNK_TILES;
+                chunk = build_chunk(tiles.get() + static_cast<size_t>(ty) * width + tx, width, tx, ty,
+                    std::min(CHUNK_TILES, width - tx), std::min(CHUNK_TILES, height - ty), tile_size, palette, offset);
+            }
+            target.draw(chunk);
+        }
+    }
+}
+
+// -------------------------
+// Streaming
+// -------------------------
+
+void LevelSystem::ChunkStream::run() {
+    std::ifstream file(_path, std::ios::binary);
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+            if (_stop) return;
+            index = _queue.front();
+            _queue.pop_front();
+        }
+        Loaded chunk = load(file, index);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finished.push_back(std::move(chunk));
+    }
+}
+
+// One seek + read per row of the chunk; the file is row-major.
+LevelSystem::ChunkStream::Loaded LevelSystem::ChunkStream::load(std::ifstream& file, size_t index) const {
+    const int x0 = static_cast<int>(index % _chunks_x) * CT;
+    const int y0 = static_cast<int>(index / _chunks_x) * CT;
+    const int w = std::min(CT, _width - x0);
+    const int h = std::min(CT, _height - y0);
+
+    Loaded chunk{ index, std::make_unique<Tile[]>(CT * CT), nullptr };
+    for (int r = 0; r < h; ++r) {
+        const uint64_t offset = sizeof(LevelFileHeader) + static_cast<uint64_t>(y0 + r) * _width + x0;
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char*>(chunk.tiles.get() + static_cast<size_t>(r) * CT), w);
+    }
+    if (!file) {
+        // Keep going with what we have rather than stall the game
+        std::cout << "Couldn't read level chunk " << x0 / CT << "," << y0 / CT << " from " << _path << "\n";
+        file.clear();
+    }
+    chunk.vertices = std::make_shared<const sf::VertexArray>(
+        build_chunk(chunk.tiles.get(), CT, x0, y0, w, h, _tile_size, _palette, _level_offset));
+    return chunk;
+}
+
+bool LevelSystem::ChunkStream::update(const std::vector<StreamPoint>& points) {
+    ++_frame;
+    bool changed = false;
+
+    std::vector<Loaded> finished;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        finished.swap(_finished);
+    }
+    for (auto& chunk : finished) {
+        _requested.erase(chunk.index);
+        _table[chunk.index] = chunk.tiles.get();
+        _resident[chunk.index] = Resident{ std::move(chunk.tiles), std::move(chunk.vertices), _frame };
+        changed = true;
+    }
+
+    // Touch everything the points cover, request what isn't here yet
+    std::vector<size_t> wanted;
+    const float chunk_size = _tile_size * CT;
+    for (const auto& p : points) {
+        const sf::Vector2f lo = (p.pos - sf::Vector2f(p.radius, p.radius) - _level_offset) / chunk_size;
+        const sf::Vector2f hi = (p.pos + sf::Vector2f(p.radius, p.radius) - _level_offset) / chunk_size;
+        const int x0 = std::max(0, static_cast<int>(std::floor(lo.x)));
+        const int y0 = std::max(0, static_cast<int>(std::floor(lo.y)));
+        const int x1 = std::min(_chunks_x - 1, static_cast<int>(std::floor(hi.x)));
+        const int y1 = std::min(_chunks_y - 1, static_cast<int>(std::floor(hi.y)));
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                const size_t index = static_cast<size_t>(cy) * _chunks_x + cx;
+                auto it = _resident.find(index);
+                if (it != _resident.end()) {
+                    it->second.last_used = _frame;
+                    continue;
+                }
+                auto [req, added] = _requested.try_emplace(index, _frame);
+                req->second = _frame;
+                if (added) wanted.push_back(index);
+            }
+        }
+    }
+
+    // Queued requests nobody asked for this frame are dropped before they're read
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto stale = std::remove_if(_queue.begin(), _queue.end(), [this](size_t index) {
+            auto it = _requested.find(index);
+            if (it->second == _frame) return false;
+            _requested.erase(it);
+            return true;
+        });
+        _queue.erase(stale, _queue.end());
+        _queue.insert(_queue.end(), wanted.begin(), wanted.end());
+    }
+    if (!wanted.empty()) _cv.notify_one();
+
+    // Least recently used go first; anything used this frame stays even
+    // if that means going over budget for a while
+    while (_resident.size() > _max_chunks) {
+        auto oldest = _resident.end();
+        for (auto it = _resident.begin(); it != _resident.end(); ++it) {
+            if (it->second.last_used == _frame) continue;
+            if (oldest == _resident.end() || it->second.last_used < oldest->second.last_used) oldest = it;
+        }
+        if (oldest == _resident.end()) break;
+        _table[oldest->first] = nullptr;
+        _resident.erase(oldest);
+        changed = true;
+    }
+    return changed;
+}
+
+std::shared_ptr<const LevelSystem::TileLayer> LevelSystem::ChunkStream::build_layer() const {
+    auto layer = std::make_shared<TileLayer>();
+    layer->chunks_x = _chunks_x;
+    layer->chunks_y = _chunks_y;
+    layer->chunk_size = _tile_size * CT;
+    layer->offset = _level_offset;
+    layer->resident.reserve(_resident.size());
+    for (const auto& [index, chunk] : _resident) {
+        layer->resident.push_back({ static_cast<int>(index % _chunks_x), static_cast<int>(index / _chunks_x), chunk.vertices });
+    }
+    return layer;
+}
+
+// Text level to binary cache one row at a time, so converting a huge map
+// never holds more than a row of it. Same rules as parse_level.
+void LevelSystem::convert_level_binary(const std::string& path, const std::string& cache, uint64_t src_size, int64_t src_time) {
+    MappedFile file(path);
+    if (!file.good()) {
+        throw std::string("Couldn't open level file: ") + path;
+    }
+    std::ofstream out(cache, std::ios::binary | std::ios::trunc);
+    if (!out.good()) {
+        throw std::string("Couldn't write level file: ") + cache;
+    }
+
+    // Placeholder until the size is known
+    LevelFileHeader header = make_header(0, 0, { 0, 0 }, 0, 0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<Tile> row;
+    int width = -1;
+    int height = 0;
+    sf::Vector2i start(0, 0);
+    size_t unknown = 0;
+    char first_unknown = 0;
+
+    auto end_row = [&]() {
+        if (width < 0) {
+            width = static_cast<int>(row.size());
+        }
+        else if (static_cast<int>(row.size()) != width) {
+            throw std::string("Can't parse level file: wrong size (row ") + std::to_string(height) + " has " +
+                std::to_string(row.size()) + " tiles, expected " + std::to_string(width) + ")";
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+        ++height;
+        row.clear();
+    };
+
+    const char* const end = file.data() + file.size();
+    for (const char* p = file.data(); p != end; ++p) {
+        const uint8_t t = CHAR_TABLE[static_cast<uint8_t>(*p)];
+        if (t < CH_SKIP) {
+            if (t == START) {
+                start = { static_cast<int>(row.size()), height };
+            }
+            row.push_back(static_cast<Tile>(t));
+        }
+        else if (t == CH_NEWLINE) {
+            end_row();
+        }
+        else if (t == CH_UNKNOWN) {
+            if (unknown++ == 0) first_unknown = *p;
+        }
+    }
+    if (!row.empty()) end_row();
+    if (width < 0) width = 0;
+
+    if (unknown != 0) {
+        std::cout << "Skipped " << unknown << " unknown tile character(s), first: '" << first_unknown << "'\n";
+    }
+
+    header = make_header(width, height, start, src_size, src_time);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out.good()) {
+        throw std::string("Couldn't write level file: ") + cache;
+    }
+}
+
+LevelSystem::LevelData LevelSystem::load_level_streamed(const std::string& path, float tile_size, const Look& look, size_t max_chunks) {
+    LevelData level;
+    level.tile_size = tile_size;
+
+    const std::string cache = get_cache_path(path);
+    uint64_t src_size = 0;
+    int64_t src_time = 0;
+    if (!source_stamp(path, src_size, src_time)) {
+        throw std::string("Couldn't open level file: ") + path;
+    }
+
+    // Only the header is read here, the tiles come in as chunks later
+    LevelFileHeader header;
+    bool cached;
+    {
+        MappedFile file(cache);
+        cached = read_header(file, header) && header.source_size == src_size && header.source_time == src_time;
+    }
+    if (!cached) {
+        convert_level_binary(path, cache, src_size, src_time);
+        MappedFile file(cache);
+        if (!read_header(file, header)) {
+            throw std::string("Couldn't read level file: ") + cache;
+        }
+    }
+
+    level.width = header.width;
+    level.height = header.height;
+    level.start_tile = { header.start_x, header.start_y };
+    level.stream = std::make_shared<ChunkStream>(cache, header.width, header.height, tile_size, max_chunks, look);
+    level.tile_layer = level.stream->build_layer();
+    std::cout << "Level " << cache << " Streaming: " << level.width << "x" << level.height << "\n";
+    return level;
+}
+
+void LevelSystem::stream_around(const std::vector<StreamPoint>& points) {
+    if (!_stream) return;
+    if (!_stream->update(points)) return;
+    _tile_layer = _stream->build_layer();
+    ++_resident_version; // What get_tile_or answers has changed
+}
+
+bool LevelSystem::is_streamed() { return _stream != nullptr; }
+
+LevelSystem::Stats LevelSystem::get_stats() {
+    Stats stats{};
+    if (_stream) {
+        stats.tiles = _stream->resident_tiles();
+        stats.tile_bytes = stats.tiles * sizeof(Tile) + _stream->table_bytes();
+    }
+    else {
+        stats.tiles = static_cast<size_t>(_width) * static_cast<size_t>(_height);
+        stats.tile_bytes = stats.tiles * sizeof(Tile);
+    }
+    if (_tile_layer) {
+        stats.vertices = _tile_layer->get_vertex_count();
+        stats.vertex_bytes = stats.vertices * sizeof(sf::Vertex);
     }
+    return stats;
 }
@@ -1,20 +1,120 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 class LevelSystem {
 public:
     // Types of tiles we support in the level file
-    enum Tile { EMPTY, START, END, WALL, ENEMY, WAYPOINT };
+    // Stored as one byte so the tile array can be written/read as-is
+    enum Tile : uint8_t { EMPTY, START, END, WALL, ENEMY, WAYPOINT, TILE_COUNT };
 
-    // Load a level text file and build tiles/sprites
-    static void load_level(const std::string& path, float tile_size = 100.f);
+    // Colour of each tile type, copied out of _colors so chunks can be
+    // built on another thread without reading the map
+    using Palette = std::array<sf::Color, TILE_COUNT>;
+
+    // Load a level text file and build tiles/tile layer.
+    // With use_cache, a binary copy is kept next to the text file (".lvl")
+    // and used instead of re-parsing as long as its stamp matches the text's
+    // current size and last write time exactly.
+    static void load_level(const std::string& path, float tile_size = 100.f, bool use_cache = true);
+
+    // The level's triangles split into square chunks of tiles, so drawing
+    // can skip every chunk outside the view. A chunk's triangles are only
+    // built the first time it is drawn; apart from that it never changes.
+    struct TileLayer {
+        static constexpr int CHUNK_TILES = 16;
+        int chunks_x = 0;
+        int chunks_y = 0;
+        float chunk_size = 0.f; // World units per chunk side
+        sf::Vector2f offset;
+
+        // Flat levels only: what the chunks are built from. The tiles are
+        // shared with the level, so this layer keeps them alive.
+        std::shared_ptr<const Tile[]> tiles;
+        int width = 0;
+        int height = 0;
+        float tile_size = 0.f;
+        Palette palette{};
+        mutable std::vector<sf::VertexArray> chunks; // Row-major, empty until first drawn
+        mutable std::mutex chunks_mutex;
+
+        // Streamed levels only: the chunks currently loaded
+        struct ResidentChunk {
+            int x;
+            int y;
+            std::shared_ptr<const sf::VertexArray> vertices;
+        };
+        std::vector<ResidentChunk> resident;
+
+        size_t get_vertex_count() const;
+        // Draw the chunks overlapping `visible` (world coordinates)
+        void draw(sf::RenderTarget& target, const sf::FloatRect& visible) const;
+    };
+
+    // Tiles of a streamed level, see load_level_streamed
+    class ChunkStream;
+
+    // Where a level is drawn and the colour of each tile type. Loaders take
+    // a copy made on the main thread with get_look(), so a loader thread
+    // never reads _offset or _colors while the main thread may change them.
+    struct Look {
+        sf::Vector2f offset;
+        Palette palette{};
+    };
+    static Look get_look();
+
+    // A loaded level that isn't live yet. Built by load_level_data on any
+    // thread, then swapped in on the main thread with commit().
+    struct LevelData {
+        std::shared_ptr<Tile[]> tiles;
+        int width = 0;
+        int height = 0;
+        float tile_size = 100.f;
+        sf::Vector2i start_tile{ 0, 0 };
+        std::shared_ptr<const TileLayer> tile_layer;
+        std::shared_ptr<ChunkStream> stream; // Set instead of tiles for streamed levels
+    };
+    static LevelData load_level_data(const std::string& path, float tile_size, const Look& look, bool use_cache = true);
+    // Make `level` live; it receives the previous level in exchange
+    static void commit(LevelData& level);
+
+    // Open a level without reading its tiles: CHUNK_TILES square chunks are
+    // read from the binary cache on a background thread as stream_around
+    // asks for them, and the least recently used are dropped once more than
+    // `max_chunks` are loaded. Memory stays bounded however big the map is.
+    static LevelData load_level_streamed(const std::string& path, float tile_size, const Look& look, size_t max_chunks = 256);
+
+    // A point to keep loaded, with everything within `radius` of it
+    struct StreamPoint {
+        sf::Vector2f pos;
+        float radius;
+    };
+    // Main thread, once a frame: takes in chunks that finished loading,
+    // requests the ones the points need and evicts past the budget.
+    // Does nothing unless the live level is streamed.
+    static void stream_around(const std::vector<StreamPoint>& points);
+    static bool is_streamed();
+
+    // Compact binary level format (header + 1 byte per tile)
+    static bool load_level_binary(const std::string& path, float tile_size = 100.f);
+    static void save_level_binary(const std::string& path);
+    static std::string get_cache_path(const std::string& path);
 
     // Draw all level tiles
-    static void render(sf::RenderWindow& window);
+    static void render(sf::RenderTarget& target);
+
+    // The level's chunked tile layer. Immutable, so another thread can
+    // keep drawing it while a new level is loaded and committed.
+    static std::shared_ptr<const TileLayer> get_tile_layer();
+
+    // World-space rectangle covered by the level's tiles
+    static sf::FloatRect get_bounds();
 
     // Colour helpers for each tile type
     static sf::Color get_color(Tile t);
@@ -24,33 +124,98 @@ public:
     static Tile get_tile(sf::Vector2i grid);
     static Tile get_tile_at(sf::Vector2f world);
 
+    // Non-throwing lookup for per-frame queries: coords off the grid, or
+    // in a streamed chunk that isn't loaded, give `outside` instead.
+    // Kept inline so hot loops don't pay a call.
+    static Tile get_tile_or(sf::Vector2i grid, Tile outside = WALL) {
+        if (static_cast<unsigned>(grid.x) >= static_cast<unsigned>(_width) ||
+            static_cast<unsigned>(grid.y) >= static_cast<unsigned>(_height)) {
+            return outside;
+        }
+        if (_tiles) {
+            return _tiles[static_cast<size_t>(grid.y) * _width + grid.x];
+        }
+        const Tile* chunk = get_chunk(grid);
+        return chunk ? chunk[chunk_offset(grid)] : outside;
+    }
+
+    // Tiles that entities can't pass through
+    static bool is_solid(Tile t) { return t == WALL; }
+
     // Convert grid coords to world position (top-left of tile)
     static sf::Vector2f get_tile_position(sf::Vector2i grid);
 
+    // Convert world position to grid coords (may be out of range)
+    static sf::Vector2i get_grid_position(sf::Vector2f world);
+    static float get_tile_size();
+
     // Level dimensions and start position
     static int get_height();
     static int get_width();
     static sf::Vector2f get_start_position();
 
+    // Bumped every time a level is made live, so caches built on it can tell
+    static uint32_t get_version();
+    // Bumped when a streamed level's chunks come in or go out. Only caches
+    // that read unloaded tiles as walls need to watch this too.
+    static uint32_t get_resident_version();
+
+    // Memory held by the live level
+    struct Stats {
+        size_t tiles;
+        size_t tile_bytes;
+        size_t vertices;
+        size_t vertex_bytes;
+    };
+    static Stats get_stats();
+
 protected:
-    // Raw tile data (row-major order)
-    static std::unique_ptr<Tile[]> _tiles;
+    // Raw tile data (row-major order), null for streamed levels
+    static std::shared_ptr<Tile[]> _tiles;
+
+    // Streamed levels: the stream, and a row-major table with a pointer to
+    // each loaded chunk's tiles (null if not loaded)
+    static std::shared_ptr<ChunkStream> _stream;
+    static const Tile* const* _chunk_table;
+    static int _chunks_x;
+    static const Tile* get_chunk(sf::Vector2i grid) {
+        constexpr int CT = TileLayer::CHUNK_TILES;
+        return _chunk_table[static_cast<size_t>(grid.y / CT) * _chunks_x + grid.x / CT];
+    }
+    static size_t chunk_offset(sf::Vector2i grid) {
+        constexpr int CT = TileLayer::CHUNK_TILES;
+        return static_cast<size_t>(grid.y % CT) * CT + grid.x % CT;
+    }
     static int _width;
     static int _height;
+    static uint32_t _version;
+    static uint32_t _resident_version;
 
     // Global offset + tile size in pixels
     static sf::Vector2f _offset;
     static float _tile_size;
 
-    // Per-tile colours and cached start position
+    // Per-tile colours, and the start tile with its cached world position
     static std::map<Tile, sf::Color> _colors;
+    static sf::Vector2i _start_tile;
     static sf::Vector2f _start_position;
 
-    // One rect per tile for drawing
-    static std::vector<std::unique_ptr<sf::RectangleShape>> _sprites;
-    static void build_sprites();
+    // Two triangles per tile, one vertex array per chunk
+    static std::shared_ptr<const TileLayer> _tile_layer;
+    static void build_tile_layer(LevelData& level, const Look& look);
+    // Triangles for a w x h block of tiles whose top-left is grid (x0, y0);
+    // `tiles` points at that tile and rows are `stride` apart
+    static sf::VertexArray build_chunk(const Tile* tiles, size_t stride, int x0, int y0, int w, int h, float tile_size,
+        const Palette& palette, sf::Vector2f offset);
+
+    // Loader helpers, all fill a staged level
+    static void parse_level(const char* data, size_t size, LevelData& level);
+    static bool read_level_binary(const std::string& path, LevelData& level);
+    static void convert_level_binary(const std::string& path, const std::string& cache, uint64_t src_size, int64_t src_time);
 
 private:
+    friend class FlowField;
+
     LevelSystem() = delete;
     ~LevelSystem() = delete;
 };
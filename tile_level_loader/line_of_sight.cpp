@@ -0,0 +1,137 @@
+#include "line_of_sight.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <thread>
+
+size_t LineOfSight::add(sf::Vector2f from, sf::Vector2f to) {
+    const sf::Vector2i a = LevelSystem::get_grid_position(from);
+    const sf::Vector2i b = LevelSystem::get_grid_position(to);
+    const auto on_grid = [](sf::Vector2i p) {
+        return p.x >= 0 && p.y >= 0 && p.x < LevelSystem::get_width() && p.y < LevelSystem::get_height();
+    };
+
+    // Key on the tiles, so any two positions in the same pair of tiles share an answer
+    const auto pack = [](sf::Vector2i p) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(p.y)) << 32 | static_cast<uint32_t>(p.x);
+    };
+    PairKey key = NO_KEY;
+    if (on_grid(a) && on_grid(b)) {
+        key = { pack(a), pack(b) };
+    }
+    _from.push_back(a);
+    _to.push_back(b);
+    _keys.push_back(key);
+    return _keys.size() - 1;
+}
+
+void LineOfSight::clear() {
+    _from.clear();
+    _to.clear();
+    _keys.clear();
+    _results.clear();
+    std::swap(_cache, _last_cache);
+    _cache.clear();
+}
+
+void LineOfSight::run() {
+    // Unloaded chunks trace as walls, so streaming invalidates answers too
+    if (_level_version != LevelSystem::get_version() || _resident_version != LevelSystem::get_resident_version()) {
+        _cache.clear();
+        _last_cache.clear();
+        _level_version = LevelSystem::get_version();
+        _resident_version = LevelSystem::get_resident_version();
+    }
+
+    // Answer from the cache where possible, collect each unknown pair once
+    const size_t n = _keys.size();
+    _results.assign(n, 0);
+    std::vector<size_t> misses;    // first query of each unknown pair
+    std::vector<size_t> waiting;   // queries whose pair is being traced
+    std::unordered_map<PairKey, size_t, PairHash> pending;
+    for (size_t i = 0; i < n; ++i) {
+        const PairKey key = _keys[i];
+        if (key == NO_KEY) continue;
+        auto it = _cache.find(key);
+        if (it != _cache.end()) {
+            _results[i] = it->second;
+            continue;
+        }
+        auto last = _last_cache.find(key);
+        if (last != _last_cache.end()) {
+            _results[i] = _cache[key] = last->second;
+            continue;
+        }
+        if (pending.try_emplace(key, misses.size()).second) {
+            misses.push_back(i);
+        }
+        waiting.push_back(i);
+    }
+    if (misses.empty()) return;
+
+    // Tracing only reads the tiles, so slices of the misses can run side by side
+    std::vector<uint8_t> traced(misses.size());
+    const auto trace_slice = [&](size_t begin, size_t end) {
+        for (size_t m = begin; m < end; ++m) {
+            traced[m] = trace(_from[misses[m]], _to[misses[m]]);
+        }
+    };
+    const size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+        misses.size() / std::max<size_t>(1, min_per_thread)));
+    if (threads == 1) {
+        trace_slice(0, misses.size());
+    }
+    else {
+        const size_t per = (misses.size() + threads - 1) / threads;
+        std::vector<std::future<void>> jobs;
+        for (size_t t = 1; t < threads; ++t) {
+            const size_t begin = std::min(misses.size(), t * per);
+            const size_t end = std::min(misses.size(), begin + per);
+            jobs.push_back(std::async(std::launch::async, trace_slice, begin, end));
+        }
+        trace_slice(0, std::min(misses.size(), per));
+        for (auto& job : jobs) job.get();
+    }
+
+    for (size_t m = 0; m < misses.size(); ++m) {
+        _cache[_keys[misses[m]]] = traced[m];
+    }
+    for (size_t i : waiting) {
+        _results[i] = traced[pending[_keys[i]]];
+    }
+}
+
+// Integer grid DDA between tile centres. At each step, compare how far
+// along the line the next vertical and next horizontal tile edges are,
+// scaled by 2 * nx * ny so everything stays in integers.
+bool LineOfSight::trace(sf::Vector2i from, sf::Vector2i to) {
+    const auto solid = [](int x, int y) { return LevelSystem::is_solid(LevelSystem::get_tile_or({ x, y })); };
+    const int nx = std::abs(to.x - from.x);
+    const int ny = std::abs(to.y - from.y);
+    const int sx = to.x > from.x ? 1 : -1;
+    const int sy = to.y > from.y ? 1 : -1;
+
+    int x = from.x;
+    int y = from.y;
+    for (int ix = 0, iy = 0; ix < nx || iy < ny;) {
+        const int64_t edge = static_cast<int64_t>(1 + 2 * ix) * ny - static_cast<int64_t>(1 + 2 * iy) * nx;
+        if (edge == 0) {
+            // Exactly through a corner: both tiles beside it block
+            if (solid(x + sx, y) || solid(x, y + sy)) return false;
+            x += sx;
+            y += sy;
+            ++ix;
+            ++iy;
+        }
+        else if (edge < 0) {
+            x += sx;
+            ++ix;
+        }
+        else {
+            y += sy;
+            ++iy;
+        }
+        if ((x != to.x || y != to.y) && solid(x, y)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "level_system.hpp"
+
+// Batched line-of-sight checks over the LevelSystem grid. Queries are
+// answered per (from tile, to tile) pair: pairs seen in the last batch come
+// from a cache until the level (or which chunks are loaded) changes, and the
+// rest are traced in parallel.
+class LineOfSight {
+public:
+    // Queue a check for the next run(); returns the index to read it with
+    size_t add(sf::Vector2f from, sf::Vector2f to);
+
+    // Answer every queued check
+    void run();
+    bool visible(size_t query) const { return _results[query] != 0; }
+
+    // Drop the queued checks ready for the next batch. Cached pairs that
+    // aren't asked for again in that batch are forgotten after it.
+    void clear();
+
+    // One uncached check: walks every tile the line between the two tile
+    // centres touches. Blocked by solid tiles between them, including
+    // either side of a corner the line passes exactly through.
+    static bool trace(sf::Vector2i from, sf::Vector2i to);
+
+    // Fewer uncached pairs than this per thread and run() stays on one thread
+    size_t min_per_thread = 256;
+
+private:
+    // Both tiles' coordinates, 32 bits each, so any map size keys uniquely
+    struct PairKey {
+        uint64_t from;
+        uint64_t to;
+        bool operator==(const PairKey& o) const { return from == o.from && to == o.to; }
+    };
+    struct PairHash {
+        size_t operator()(const PairKey& k) const {
+            return std::hash<uint64_t>()(k.from * 0x9E3779B97F4A7C15ull ^ k.to);
+        }
+    };
+    static constexpr PairKey NO_KEY{ UINT64_MAX, UINT64_MAX }; // an end is off the grid
+
+    std::vector<sf::Vector2i> _from; // per query
+    std::vector<sf::Vector2i> _to;
+    std::vector<PairKey> _keys;
+    std::vector<uint8_t> _results;
+
+    std::unordered_map<PairKey, uint8_t, PairHash> _cache;      // pairs answered this batch
+    std::unordered_map<PairKey, uint8_t, PairHash> _last_cache; // and the one before
+    uint32_t _level_version = 0;
+    uint32_t _resident_version = 0;
+};